@@ -0,0 +1,215 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "match_rules.h"
+#include "move_simd.h"
+#include "rng.h"
+
+// Microbenchmark of the movement kernels: LANES players stepped for STEPS rounds towards
+// a ball that jumps around every round, 10^6 player-steps by default. Every kernel starts
+// from the same state and must end bit-identical to the scalar rule
+#define DEFAULT_LANES 10000
+#define DEFAULT_STEPS 100
+#define DEFAULT_REPEATS 5
+
+/* ==================== STRUCTS ====================*/
+typedef struct {
+    int lanes, steps, repeats;
+    uint64_t seed;
+} Options;
+
+typedef struct {
+    int *prevX, *prevY, *currX, *currY, *reached, *speed;
+} LaneState;
+
+/* ===================== UTILS =====================*/
+int *allocLane(int count) {
+    int *lane = calloc(count, sizeof(int));
+    if (lane == NULL) {
+        fprintf(stderr, "Out of memory for %d lanes\n", count);
+        exit(1);
+    }
+    return lane;
+}
+
+void allocState(LaneState *state, int count) {
+    state->prevX = allocLane(count);
+    state->prevY = allocLane(count);
+    state->currX = allocLane(count);
+    state->currY = allocLane(count);
+    state->reached = allocLane(count);
+    state->speed = allocLane(count);
+}
+
+void freeState(LaneState *state) {
+    free(state->prevX);
+    free(state->prevY);
+    free(state->currX);
+    free(state->currY);
+    free(state->reached);
+    free(state->speed);
+}
+
+void copyState(LaneState *to, LaneState *from, int count) {
+    memcpy(to->prevX, from->prevX, count * sizeof(int));
+    memcpy(to->prevY, from->prevY, count * sizeof(int));
+    memcpy(to->currX, from->currX, count * sizeof(int));
+    memcpy(to->currY, from->currY, count * sizeof(int));
+    memcpy(to->reached, from->reached, count * sizeof(int));
+    memcpy(to->speed, from->speed, count * sizeof(int));
+}
+
+int sameState(LaneState *state, LaneState *other, int count) {
+    size_t size = count * sizeof(int);
+    return memcmp(state->prevX, other->prevX, size) == 0 && memcmp(state->prevY, other->prevY, size) == 0
+        && memcmp(state->currX, other->currX, size) == 0 && memcmp(state->currY, other->currY, size) == 0
+        && memcmp(state->reached, other->reached, size) == 0;
+}
+
+double getWallTime() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/* ===================== BENCH =====================*/
+double runKernel(MoveKernel move, LaneState *state, int **ballX, int **ballY, uint64_t *seeds, Options *options) {
+    MoveLanes lanes;
+    lanes.prevX = state->prevX;
+    lanes.prevY = state->prevY;
+    lanes.currX = state->currX;
+    lanes.currY = state->currY;
+    lanes.reached = state->reached;
+    lanes.speed = state->speed;
+    lanes.seeds = seeds;
+
+    double start = getWallTime();
+    int r;
+    for (r = 0; r < options->steps; r++) {
+        lanes.ballX = ballX[r];
+        lanes.ballY = ballY[r];
+        move(&lanes, options->lanes, 0, r);
+    }
+    return getWallTime() - start;
+}
+
+void parseOptions(int argc, char *argv[], Options *options) {
+    options->lanes = DEFAULT_LANES;
+    options->steps = DEFAULT_STEPS;
+    options->repeats = DEFAULT_REPEATS;
+    options->seed = 1;
+
+    int i;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--lanes") == 0 && i + 1 < argc) {
+            options->lanes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+            options->steps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) {
+            options->repeats = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options->seed = strtoull(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "Unknown option %s\nUsage: %s [--lanes N] [--steps N] [--repeats N] [--seed N]\n", argv[i], argv[0]);
+            exit(1);
+        }
+    }
+
+    if (options->lanes < 1) {
+        options->lanes = 1;
+    }
+    if (options->steps < 1) {
+        options->steps = 1;
+    }
+    if (options->repeats < 1) {
+        options->repeats = 1;
+    }
+}
+
+/* ======================== MAIN =========================*/
+int main(int argc, char *argv[]) {
+    Options options;
+    parseOptions(argc, argv, &options);
+    int count = options.lanes;
+
+    // Players start like real ones, with random positions and speeds
+    LaneState initial, reference, state;
+    allocState(&initial, count);
+    allocState(&reference, count);
+    allocState(&state, count);
+    uint64_t *seeds = malloc(count * sizeof(uint64_t));
+    int m, r;
+    for (m = 0; m < count; m++) {
+        Player player;
+        seeds[m] = options.seed + m;
+        initPlayerState(m % PLAYERS, &player, seeds[m]);
+        initial.prevX[m] = player.prevX;
+        initial.prevY[m] = player.prevY;
+        initial.currX[m] = player.currX;
+        initial.currY[m] = player.currY;
+        initial.speed[m] = player.speed;
+    }
+
+    // A fresh ball position per lane and round, drawn up front so it is not timed
+    int **ballX = malloc(options.steps * sizeof(int *));
+    int **ballY = malloc(options.steps * sizeof(int *));
+    for (r = 0; r < options.steps; r++) {
+        ballX[r] = allocLane(count);
+        ballY[r] = allocLane(count);
+        for (m = 0; m < count; m++) {
+            RngBlock draws = rngBlock(seeds[m], r, RNG_NO_PLAYER, RNG_KICK);
+            ballX[r][m] = rngBelow(draws.v[0], FIELD_LENGTH);
+            ballY[r][m] = rngBelow(draws.v[1], FIELD_WIDTH);
+        }
+    }
+
+    double steps = (double) count * options.steps;
+    double scalarTime = 0;
+    int failed = FALSE;
+    int kernel;
+    printf("lanes=%d steps=%d player-steps=%.0f\n", count, options.steps, steps);
+    for (kernel = MOVE_KERNEL_SCALAR; kernel <= MOVE_KERNEL_AVX2; kernel++) {
+        if (resolveMoveKernel(kernel) != kernel) {
+            printf("%-6s unsupported on this CPU\n", getMoveKernelName(kernel));
+            continue;
+        }
+
+        // Best of several repeats, each from the same initial state
+        double best = 0;
+        int i;
+        for (i = 0; i < options.repeats; i++) {
+            copyState(&state, &initial, count);
+            double elapsed = runKernel(getMoveKernel(kernel), &state, ballX, ballY, seeds, &options);
+            if (i == 0 || elapsed < best) {
+                best = elapsed;
+            }
+        }
+
+        int identical = TRUE;
+        if (kernel == MOVE_KERNEL_SCALAR) {
+            scalarTime = best;
+            copyState(&reference, &state, count);
+        } else {
+            identical = sameState(&state, &reference, count);
+            failed |= !identical;
+        }
+        printf("%-6s %.3fms %.2fns/step speedup=%.2fx %s\n", getMoveKernelName(kernel), best * 1e3,
+            best * 1e9 / steps, scalarTime / best, identical ? "identical" : "MISMATCH");
+    }
+
+    for (r = 0; r < options.steps; r++) {
+        free(ballX[r]);
+        free(ballY[r]);
+    }
+    free(ballX);
+    free(ballY);
+    free(seeds);
+    freeState(&initial);
+    freeState(&reference);
+    freeState(&state);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,320 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "match_rules.h"
+#include "move_simd.h"
+
+// Ensemble engine: advances many independent matches together, match m uses seed + m so
+// it plays exactly like match_mpi or match_threads started with that seed. Prints one
+// summary line per match:
+// match seed goalsA goalsB passesA passesB shotsA shotsB outsA outsB
+//       speedA speedB dribbleA dribbleB kickA kickB
+// where shots are kicks towards goal that stayed in the field, outs are kicks that left
+// it, and the last six columns are the team totals of each player stat
+#define DEFAULT_MATCHES 1000
+
+/* ==================== STRUCTS ====================*/
+typedef struct {
+    int matches, timing, hasSeed, kernel;
+    uint64_t seed;
+} Options;
+
+typedef struct {
+    int matches;
+    MoveKernel move;
+
+    // Player state, player p of match m lives at [p * matches + m] so that one player
+    // index forms a contiguous lane across all matches
+    int *prevX, *prevY, *currX, *currY;
+    int *reached, *kicked, *challenge;
+    int *speed, *dribble, *kick;
+
+    // Match state, indexed by match
+    int *ballX, *ballY;
+    uint64_t *seeds;
+    int *goals[TEAMS], *passes[TEAMS], *shots[TEAMS], *outs[TEAMS];
+} Ensemble;
+
+/* ===================== INIT =====================*/
+int *allocLane(int count) {
+    int *lane = calloc(count, sizeof(int));
+    if (lane == NULL) {
+        fprintf(stderr, "Out of memory for %d matches\n", count);
+        exit(1);
+    }
+    return lane;
+}
+
+void initEnsemble(Ensemble *ensemble, int matches, uint64_t seed, int kernel) {
+    int players = PLAYERS * matches;
+    ensemble->matches = matches;
+    ensemble->move = getMoveKernel(kernel);
+    ensemble->prevX = allocLane(players);
+    ensemble->prevY = allocLane(players);
+    ensemble->currX = allocLane(players);
+    ensemble->currY = allocLane(players);
+    ensemble->reached = allocLane(players);
+    ensemble->kicked = allocLane(players);
+    ensemble->challenge = allocLane(players);
+    ensemble->speed = allocLane(players);
+    ensemble->dribble = allocLane(players);
+    ensemble->kick = allocLane(players);
+    ensemble->ballX = allocLane(matches);
+    ensemble->ballY = allocLane(matches);
+    ensemble->seeds = malloc(matches * sizeof(uint64_t));
+
+    int t;
+    for (t = 0; t < TEAMS; t++) {
+        ensemble->goals[t] = allocLane(matches);
+        ensemble->passes[t] = allocLane(matches);
+        ensemble->shots[t] = allocLane(matches);
+        ensemble->outs[t] = allocLane(matches);
+    }
+
+    // Initialize ball position in the center and all players randomly
+    int m, p;
+    for (m = 0; m < matches; m++) {
+        ensemble->seeds[m] = seed + m;
+        ensemble->ballX[m] = FIELD_LENGTH / 2;
+        ensemble->ballY[m] = FIELD_WIDTH / 2;
+        for (p = 0; p < PLAYERS; p++) {
+            Player player;
+            int i = p * matches + m;
+            initPlayerState(p, &player, ensemble->seeds[m]);
+            ensemble->prevX[i] = player.prevX;
+            ensemble->prevY[i] = player.prevY;
+            ensemble->currX[i] = player.currX;
+            ensemble->currY[i] = player.currY;
+            ensemble->speed[i] = player.speed;
+            ensemble->dribble[i] = player.dribble;
+            ensemble->kick[i] = player.kick;
+        }
+    }
+}
+
+void freeEnsemble(Ensemble *ensemble) {
+    free(ensemble->prevX);
+    free(ensemble->prevY);
+    free(ensemble->currX);
+    free(ensemble->currY);
+    free(ensemble->reached);
+    free(ensemble->kicked);
+    free(ensemble->challenge);
+    free(ensemble->speed);
+    free(ensemble->dribble);
+    free(ensemble->kick);
+    free(ensemble->ballX);
+    free(ensemble->ballY);
+    free(ensemble->seeds);
+
+    int t;
+    for (t = 0; t < TEAMS; t++) {
+        free(ensemble->goals[t]);
+        free(ensemble->passes[t]);
+        free(ensemble->shots[t]);
+        free(ensemble->outs[t]);
+    }
+}
+
+/* ===================== ROUND =====================*/
+void loadPlayer(Ensemble *ensemble, int match, int index, Player *player) {
+    int i = index * ensemble->matches + match;
+    player->prevX = ensemble->prevX[i];
+    player->prevY = ensemble->prevY[i];
+    player->currX = ensemble->currX[i];
+    player->currY = ensemble->currY[i];
+    player->team = index < PLAYERS_PER_TEAM ? TEAM_A : TEAM_B;
+    player->reached = ensemble->reached[i];
+    player->kicked = ensemble->kicked[i];
+    player->challenge = ensemble->challenge[i];
+    player->speed = ensemble->speed[i];
+    player->dribble = ensemble->dribble[i];
+    player->kick = ensemble->kick[i];
+}
+
+void resolveKick(Ensemble *ensemble, int match, int round) {
+    int matches = ensemble->matches;
+    uint64_t seed = ensemble->seeds[match];
+
+    // Only players that reached the ball can win the challenge
+    KickClaim winner;
+    winner.challenge = PLAYER_NO_CHALLENGE;
+    winner.key = 0;
+    winner.player = DO_NOT_EXIST;
+    int p;
+    for (p = 0; p < PLAYERS; p++) {
+        int i = p * matches + match;
+        if (ensemble->reached[i] == PLAYER_REACHED_BALL) {
+            Player player;
+            KickClaim claim;
+            loadPlayer(ensemble, match, p, &player);
+            makeKickClaim(p, &player, round, seed, &claim);
+            ensemble->challenge[i] = player.challenge;
+            if (kickClaimBeats(&claim, &winner)) {
+                winner = claim;
+            }
+        }
+    }
+    if (winner.challenge == PLAYER_NO_CHALLENGE) {
+        return;
+    }
+
+    int positions[PLAYERS][2];
+    for (p = 0; p < PLAYERS; p++) {
+        positions[p][0] = ensemble->currX[p * matches + match];
+        positions[p][1] = ensemble->currY[p * matches + match];
+    }
+
+    Player kicker;
+    Ball ball;
+    ensemble->kicked[winner.player * matches + match] = PLAYER_KICKED_BALL;
+    loadPlayer(ensemble, match, winner.player, &kicker);
+    ball.x = ensemble->ballX[match];
+    ball.y = ensemble->ballY[match];
+
+    int outcome = playerKickBall(winner.player, &kicker, &ball, positions, round, seed);
+    ensemble->ballX[match] = ball.x;
+    ensemble->ballY[match] = ball.y;
+
+    int team = kicker.team;
+    if (outcome == KICK_GOAL) {
+        ensemble->goals[team][match]++;
+    } else if (outcome == KICK_PASS) {
+        ensemble->passes[team][match]++;
+    } else if (outcome == KICK_TOWARDS_GOAL) {
+        ensemble->shots[team][match]++;
+    } else if (outcome == KICK_OUT_OF_FIELD) {
+        ensemble->outs[team][match]++;
+    }
+}
+
+void stepEnsemble(Ensemble *ensemble, int round) {
+    int matches = ensemble->matches;
+    int players = PLAYERS * matches;
+
+    // Reset the round data for every player of every match
+    int i;
+    for (i = 0; i < players; i++) {
+        ensemble->reached[i] = PLAYER_NO_REACHED_BALL;
+        ensemble->kicked[i] = PLAYER_NO_KICKED_BALL;
+        ensemble->challenge[i] = PLAYER_NO_CHALLENGE;
+    }
+
+    // Move one player index across all matches at a time
+    int p;
+    for (p = 0; p < PLAYERS; p++) {
+        MoveLanes lanes;
+        int offset = p * matches;
+        lanes.prevX = &ensemble->prevX[offset];
+        lanes.prevY = &ensemble->prevY[offset];
+        lanes.currX = &ensemble->currX[offset];
+        lanes.currY = &ensemble->currY[offset];
+        lanes.reached = &ensemble->reached[offset];
+        lanes.speed = &ensemble->speed[offset];
+        lanes.ballX = ensemble->ballX;
+        lanes.ballY = ensemble->ballY;
+        lanes.seeds = ensemble->seeds;
+        ensemble->move(&lanes, matches, p, round);
+    }
+
+    int m;
+    for (m = 0; m < matches; m++) {
+        resolveKick(ensemble, m, round);
+    }
+}
+
+void printSummaries(Ensemble *ensemble) {
+    int matches = ensemble->matches;
+    int m, p;
+    for (m = 0; m < matches; m++) {
+        int speed[TEAMS] = {0, 0};
+        int dribble[TEAMS] = {0, 0};
+        int kick[TEAMS] = {0, 0};
+        for (p = 0; p < PLAYERS; p++) {
+            int team = p < PLAYERS_PER_TEAM ? TEAM_A : TEAM_B;
+            speed[team] += ensemble->speed[p * matches + m];
+            dribble[team] += ensemble->dribble[p * matches + m];
+            kick[team] += ensemble->kick[p * matches + m];
+        }
+
+        printf("%d %" PRIu64 " %d %d %d %d %d %d %d %d %d %d %d %d %d %d\n", m, ensemble->seeds[m],
+            ensemble->goals[TEAM_A][m], ensemble->goals[TEAM_B][m],
+            ensemble->passes[TEAM_A][m], ensemble->passes[TEAM_B][m],
+            ensemble->shots[TEAM_A][m], ensemble->shots[TEAM_B][m],
+            ensemble->outs[TEAM_A][m], ensemble->outs[TEAM_B][m],
+            speed[TEAM_A], speed[TEAM_B], dribble[TEAM_A], dribble[TEAM_B], kick[TEAM_A], kick[TEAM_B]);
+    }
+}
+
+/* =============== OPTIONS AND TIMING ===============*/
+void parseOptions(int argc, char *argv[], Options *options) {
+    options->matches = DEFAULT_MATCHES;
+    options->timing = FALSE;
+    options->hasSeed = FALSE;
+    options->kernel = MOVE_KERNEL_AUTO;
+
+    int i;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--matches") == 0 && i + 1 < argc) {
+            options->matches = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--timing") == 0) {
+            options->timing = TRUE;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options->hasSeed = TRUE;
+            options->seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc && parseMoveKernel(argv[i + 1]) != DO_NOT_EXIST) {
+            options->kernel = parseMoveKernel(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown option %s\nUsage: %s [--matches N] [--timing] [--seed N] [--kernel scalar|sse|avx2|auto]\n", argv[i], argv[0]);
+            exit(1);
+        }
+    }
+
+    if (options->matches < 1) {
+        options->matches = 1;
+    }
+
+    // Fall back to the widest movement kernel this CPU supports
+    options->kernel = resolveMoveKernel(options->kernel);
+}
+
+double getWallTime() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/* ======================== MAIN =========================*/
+int main(int argc, char *argv[]) {
+    Options options;
+    parseOptions(argc, argv, &options);
+
+    uint64_t seed = options.hasSeed ? options.seed : (uint64_t) time(0);
+    if (!options.hasSeed) {
+        fprintf(stderr, "seed=%" PRIu64 "\n", seed);
+    }
+
+    Ensemble ensemble;
+    double start = getWallTime();
+    initEnsemble(&ensemble, options.matches, seed, options.kernel);
+
+    int r;
+    for (r = 0; r < ROUNDS; r++) {
+        stepEnsemble(&ensemble, r);
+    }
+    double elapsed = getWallTime() - start;
+
+    printSummaries(&ensemble);
+    if (options.timing) {
+        // The engine is single threaded, so this is the throughput of one core
+        fprintf(stderr, "matches=%d rounds=%d kernel=%s total=%.3fs matches/s/core=%.1f\n",
+            options.matches, ROUNDS, getMoveKernelName(options.kernel), elapsed, options.matches / elapsed);
+    }
+
+    freeEnsemble(&ensemble);
+
+    return 0;
+}
@@ -1,157 +1,440 @@
+#include <inttypes.h>
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
-#define TRUE 1
-#define FALSE 0
-#define DO_NOT_EXIST -1
-#define UP 1
-#define RIGHT 1
-#define DOWN -1
-#define LEFT -1
-
-#define FIELD_WIDTH 96
-#define FIELD_LENGTH 128
-#define SUBFIELD_WIDTH 32
-#define SUBFIELD_LENGTH 32
-
-#define GOAL_LEFT_START_X 0
-#define GOAL_LEFT_START_Y 43
-#define GOAL_LEFT_END_X 0
-#define GOAL_LEFT_END_Y 51
-#define GOAL_RIGHT_START_X 127
-#define GOAL_RIGHT_START_Y 43
-#define GOAL_RIGHT_END_X 127
-#define GOAL_RIGHT_END_Y 51
-
-#define ROUNDS 2700
-#define TEAMS 2
-#define PROCS 34
-#define FIELDS 12
-#define PLAYERS 22
-#define PLAYERS_PER_TEAM 11
-
-#define PLAYER_STAT_MAX 10
-#define PLAYER_ALL_MAX 15
-#define PLAYER_REACHED_BALL 1
-#define PLAYER_NO_REACHED_BALL 0
-#define PLAYER_KICKED_BALL 1
-#define PLAYER_NO_KICKED_BALL 0
-#define PLAYER_NO_CHALLENGE -1
+#include "match_rules.h"
+#include "profile.h"
+#include "trace.h"
+
+// Persistent collectives come with MPI 4, Open MPI offered them earlier as an extension
+#if MPI_VERSION >= 4
+#define PERSISTENT_COLLECTIVES
+#elif defined(OPEN_MPI) && OPEN_MPI
+#include <mpi-ext.h>
+#if defined(OMPI_HAVE_MPI_EXT_PCOLLREQ) && OMPI_HAVE_MPI_EXT_PCOLLREQ
+#define PERSISTENT_COLLECTIVES
+#define MPI_Allgatherv_init MPIX_Allgatherv_init
+#define MPI_Allreduce_init MPIX_Allreduce_init
+#define MPI_Bcast_init MPIX_Bcast_init
+#define MPI_Barrier_init MPIX_Barrier_init
+#endif
+#endif
 
 #define COMM_FIELDS 0
-#define COMM_A 1
-#define COMM_B 2
-
-#define TEAM_A 0
-#define TEAM_B 1
+#define COMM_PLAYERS 1
+
+// Halo schedule: field processes only talk to the Moore neighbourhood of their subfield.
+// A player moves at most PLAYER_STAT_MAX squares, so it never leaves that neighbourhood
+// in one round, and a kick reaches at most KICK_RANGE_MAX squares, no more than a
+// subfield, so every teammate a kicker can pass to is in a neighbouring subfield
+#define HALO_NEIGHBOURS 8
+#define HALO_RECORD_INTS (1 + (int) (sizeof(Player) / sizeof(int)))
+#define HALO_GHOST_INTS 3
+#define HALO_KICK_RANGE KICK_RANGE_MAX
+
+// Delta schedule: fields only hear about the players and the ball that enter their
+// subfields, a notice is an index, x, y triple and the ball has an index of its own
+#define DELTA_NOTICE_INTS 3
+#define DELTA_BALL (-2)
+#define TAG_BALL_HANDOVER 1
+#define TAG_KICK_POSITIONS 2
+#define TAG_DELTA_NOTICE 3
+
+// Local kicks: the process hosting the kicker hands the new ball position to the field
+// process that held the ball, which publishes it to the other fields
+#define TAG_KICKED_BALL 4
+
+// The halo and delta schedules tag the record of player p with TAG_PLAYER_RECORD + p, so
+// this range must stay after every fixed tag
+#define TAG_PLAYER_RECORD 5
+
+// Checkpoints: a file holds two slots written in turn, so a run killed while writing one
+// can still restart from the other
+#define CHECKPOINT_MAGIC "FBCKPT1"
+#define CHECKPOINT_SLOTS 2
+#define CHECKPOINT_EVERY 100
+
+// Profiled phases of a round
+#define PHASE_BROADCAST_BALL 0
+#define PHASE_MOVE 1
+#define PHASE_BARRIER 2
+#define PHASE_GATHER_PLAYERS 3
+#define PHASE_UPDATE_POSITIONS 4
+#define PHASE_UPDATE_DATA 5
+#define PHASE_DETERMINE_KICKER 6
+#define PHASE_KICK_BALL 7
+#define PHASE_UPDATE_BALL 8
+#define PHASE_GATHER_OUTPUT 9
+#define PHASE_MIGRATE_PLAYERS 10
+#define PHASE_EXCHANGE_HALO 11
+#define PHASE_PUT_RECORDS 12
+#define PHASE_FETCH_POSITIONS 13
+#define PHASE_EXCHANGE_DELTAS 14
+#define PHASE_WRITE_CHECKPOINT 15
+#define PHASE_BALANCE_SUBFIELDS 16
+#define PHASES 17
 
 /* ==================== STRUCTS ====================*/
 typedef struct {
-    int x, y;
-} Ball;
+    // The first fieldRanks ranks host contiguous blocks of subfields, the last playerRanks
+    // ranks host contiguous blocks of players. In hybrid layouts the two overlap and a rank
+    // hosts both, otherwise firstPlayerRank == fieldRanks
+    int procs, fieldRanks, playerRanks, firstPlayerRank;
+    int fields, players;
+
+    // Ownership map: field process f hosts subfields tileStarts[f] up to tileStarts[f + 1],
+    // subfield t is hosted by tileRanks[t]. Every process holds the same map
+    int *tileStarts;
+    int *tileRanks;
+} Layout;
 
 typedef struct {
-    int prevX, prevY, currX, currY;
-    int team, reached, kicked, challenge;
-    int speed, dribble, kick;
-} Player;
+    // Both point into the storage block of the hosting process, one ball slot followed by
+    // one record slot per player for every subfield
+    Ball *ball;
+    Player *players;
+} Field;
 
 typedef struct {
-    Ball ball;
-    Player players[PLAYERS];
-} Field;
+    // The subfields a field process hosts, or the players a player process hosts
+    int firstTile, tiles;
+    Field *fields;
+    char *storage;
+    int ownsStorage;
+    int firstPlayer, count;
+    Player *players;
+} Hosted;
+
+typedef struct {
+    // Buffers of one round output gather, they stay untouched while it is in flight. Each
+    // field process sends to it through source sourceOf[rank], which is its own rank unless
+    // a node leader sends for it
+    int sources;
+    int *sourceOf;
+    int *sendBuffer;
+    int *receiveBuffer;
+    uint64_t *sendWords;
+    uint64_t *receiveWords;
+    int *receiveCounts;
+    int *displacements;
+    int *owners;
+    char *owned;
+    char *allOwned;
+    int round;
+    MPI_Request request;
+} OutputGather;
+
+typedef struct {
+    // Every collective of a round has fixed buffers, counts and roots. With persistent
+    // collectives they are set up once and only started each round, otherwise the
+    // matching non-blocking collective is posted
+    MPI_Comm gatherComm;
+    Player *player;
+    Player *players;
+    int *playerCounts;
+    int *playerDisplacements;
+    KickClaim claim, winner;
+    int (*fieldBalls)[2];
+    int (*kickedBalls)[2];
+    MPI_Request playerRequest;
+    MPI_Request claimRequest;
+    MPI_Request *fieldBallRequests;
+    MPI_Request *kickedBallRequests;
+    MPI_Request barrierRequest;
+} RoundCollectives;
+
+typedef struct {
+    // Subfields form a Cartesian grid of the field processes, which the library may
+    // reorder, so a field process hosts subfield tile and not necessarily its rank
+    MPI_Comm cart, neighbourhood;
+    int tile;
+    int *tileRanks;
+    int neighbours;
+    int neighbourRanks[HALO_NEIGHBOURS];
+    int neighbourTiles[HALO_NEIGHBOURS];
+
+    // One fixed slot per neighbour, only the counted part of it is sent
+    int sendCounts[HALO_NEIGHBOURS], sendDisplacements[HALO_NEIGHBOURS];
+    int receiveCounts[HALO_NEIGHBOURS], receiveDisplacements[HALO_NEIGHBOURS];
+    int *sendBuffer;
+    int *receiveBuffer;
+    Player *records;
+    MPI_Request *recordRequests;
+} Halo;
+
+typedef struct {
+    // One-sided transport: every field process exposes one record slot per player for
+    // each subfield it hosts, and players put their records straight into the slot of the
+    // subfield that owns them. Fields only read the window between fences
+    MPI_Win win;
+    Player *inbox;
+
+    // Per hosted player, the subfield its record went to last and the record that clears
+    // the slot it leaves, which stays untouched until the next fence
+    int *ownerTiles;
+    Player *leaving;
+
+    // Every slot of every field, only filled on the process hosting the kicker
+    Player *fetched;
+} Rma;
+
+typedef struct {
+    // Field processes on one node keep their subfields in one shared segment. The first of
+    // them leads the node: it alone takes part in the player gather, into records in its
+    // part of the segment, and in the output gather for every subfield on the node
+    MPI_Comm node, leaders, gather;
+    MPI_Win win;
+    int leader, nodeSize;
+    int *worldRanks;
+    char *storage;
+    Player *records;
+    Hosted view;
+} SharedFields;
+
+typedef struct {
+    // Delta schedule: a field process knows which players its subfields own, players only
+    // report to that process and fields hand players and the ball on as they cross over.
+    // The field communicator numbers field processes like the match communicator
+    MPI_Comm fieldComm, playerComm;
+    int fieldRank;
+    char *owned;
+    Player *records;
+    MPI_Request *requests;
+    MPI_Status *statuses;
+
+    // One fixed slot of notices per field process, only the counted part of it is sent
+    int *sendCounts;
+    int *messages;
+    int *sendBuffer;
+    int *receiveBuffer;
+
+    // The ball a kick sent out of the subfields of this process, until it is handed on
+    int ballLeaving;
+    int leavingBall[2];
+
+    // Positions the fields report to the kicker, one slot per field process
+    int *positionBuffer;
+    int *kickBuffer;
+} Delta;
+
+typedef struct {
+    // Subfields are handed between field processes every few rounds so each hosts about the
+    // same load. A subfield costs one unit a round plus one for every player standing in it,
+    // summed over the rounds since the last handover
+    int every;
+    int *weights;
+    int *totals;
+    int *starts;
+    int *sendCounts, *sendDisplacements;
+    int *receiveCounts, *receiveDisplacements;
+} Balance;
+
+typedef struct {
+    // Leads every checkpoint slot. The slot then holds every player record in player order
+    // and every subfield block in tile order, so a run can restart on another layout
+    char magic[8];
+    int round;
+    int fieldLength, fieldWidth, subfieldLength, subfieldWidth;
+    int players, fields;
+    uint64_t seed, checksum;
+} CheckpointHeader;
+
+typedef struct {
+    MPI_File file;
+    int every, written;
+    MPI_Offset slotBytes;
+    CheckpointHeader header;
+} Checkpoint;
+
+typedef struct {
+    // Compact wire codec: player records travel as one word of round state each, every
+    // process learns the team and stats of every player once at start
+    int compact;
+    uint32_t *stats;
+    uint64_t *hostedWords;
+    uint64_t *words;
+} Wire;
+
+typedef struct {
+    // Tournament mode: MPI_COMM_WORLD splits into matches of matchRanks consecutive
+    // processes, and every message of a match stays on its own communicator. Without it
+    // the one match spans MPI_COMM_WORLD
+    int active, matches, match, matchRanks;
+    MPI_Comm comm;
+} Tournament;
+
+typedef struct {
+    // What a match produced, summed over its processes at the end. Kicks count for the team
+    // of the kicker, the stats are team totals
+    int goals[TEAMS], passes[TEAMS], shots[TEAMS], outs[TEAMS];
+    int speed[TEAMS], dribble[TEAMS], kick[TEAMS];
+} Result;
+
+typedef struct {
+    int dataflow, pipeline, halo, hybrid, rma, sharedFields, delta, localKick, compact, timing, profile, hasSeed;
+    uint64_t seed;
+    char *tracePath;
+    char *checkpointPath;
+    int checkpointEvery, restart;
+    int balance;
+    int matchRanks;
+    MatchConfig config;
+    int fieldRanks, playerRanks;
+} Options;
+
+const ProfilePhase phases[PHASES] = {
+    {"broadcastBallPosition", PROFILE_WAIT},
+    {"movePlayers", PROFILE_COMPUTE},
+    {"barrier", PROFILE_WAIT},
+    {"gatherPlayers", PROFILE_WAIT},
+    {"updatePlayerPositions", PROFILE_COMPUTE},
+    {"updatePlayerData", PROFILE_COMPUTE},
+    {"determineKicker", PROFILE_WAIT},
+    {"kickBall", PROFILE_COMPUTE},
+    {"updateBallPosition", PROFILE_WAIT},
+    {"gatherRoundOutput", PROFILE_WAIT},
+    {"migratePlayers", PROFILE_WAIT},
+    {"exchangeHalo", PROFILE_WAIT},
+    {"putPlayerRecords", PROFILE_WAIT},
+    {"fetchKickPositions", PROFILE_WAIT},
+    {"exchangeDeltas", PROFILE_WAIT},
+    {"writeCheckpoint", PROFILE_WAIT},
+    {"balanceSubfields", PROFILE_WAIT},
+};
+
+Layout layout;
+Wire wire;
+Tournament tournament;
 
 /* ===================== UTILS =====================*/
-// 0-11: Field processes
-// 12-22: Team A players
-// 23-33: Team B players
+void *allocOrAbort(size_t size) {
+    void *memory = calloc(1, size);
+    if (memory == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    return memory;
+}
+
+void abortWithError(int rank, const char *message) {
+    // Every match of a tournament fails the same way, the first one reports it
+    if (rank == 0 && tournament.match == 0) {
+        fprintf(stderr, "Cannot run this match: %s\n", message);
+    }
+    MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+// Block b of n items starts at item b * n / blocks, item i lands in block
+// ((i + 1) * blocks - 1) / n
+int getBlockStart(int block, int blocks, int items) {
+    return (int) ((long) block * items / blocks);
+}
+
+int getBlockOwner(int item, int blocks, int items) {
+    return (int) ((((long) item + 1) * blocks - 1) / items);
+}
+
 int isField(int rank) {
-    return rank >= 0 && rank <= 11 ? TRUE : FALSE;
+    return rank >= 0 && rank < layout.fieldRanks ? TRUE : FALSE;
 }
 
-int isTeamA(int rank) {
-    return rank >= 12 && rank <= 22 ? TRUE : FALSE;
+int getFirstTile(int rank) {
+    return layout.tileStarts[rank];
 }
 
-int isTeamB(int rank) {
-    return rank >= 23 && rank <= 33 ? TRUE : FALSE;
+int getTileCount(int rank) {
+    return isField(rank) ? getFirstTile(rank + 1) - getFirstTile(rank) : 0;
 }
 
-int playerIsInField(Field *field, int playerRank) {
-    return 
-        field->players[playerRank - FIELDS].currX != DO_NOT_EXIST && 
-        field->players[playerRank - FIELDS].currY != DO_NOT_EXIST ? TRUE : FALSE;
+int getTileRank(int tile) {
+    return layout.tileRanks[tile];
 }
 
-int ballIsInField(Field *field) {
-    return field->ball.x != DO_NOT_EXIST && field->ball.y != DO_NOT_EXIST ? TRUE : FALSE;
+int getOwnerRank(int x, int y) {
+    return getTileRank(getFieldRankFromCoords(x, y));
 }
 
-int getFieldRankFromCoords(int x, int y) {
-    if (x == DO_NOT_EXIST || y == DO_NOT_EXIST) {
-        return DO_NOT_EXIST;
+void setTileStarts(int *starts) {
+    // Takes over a new ownership map, starts has fieldRanks + 1 entries
+    int f, t;
+    for (f = 0; f <= layout.fieldRanks; f++) {
+        layout.tileStarts[f] = starts[f];
+    }
+    for (f = 0; f < layout.fieldRanks; f++) {
+        for (t = starts[f]; t < starts[f + 1]; t++) {
+            layout.tileRanks[t] = f;
+        }
     }
+}
+
+int hostsPlayers(int rank) {
+    return rank >= layout.firstPlayerRank && rank < layout.procs ? TRUE : FALSE;
+}
 
-    int numRows = FIELD_WIDTH / SUBFIELD_WIDTH;
-    int numCols = FIELD_LENGTH / SUBFIELD_LENGTH;
-    int row = y / SUBFIELD_WIDTH;
-    int col = x / SUBFIELD_LENGTH;
-    // printf("row=%d, col=%d\n", row, col);
-    return col + row * numCols;
+int getFirstPlayer(int rank) {
+    return getBlockStart(rank - layout.firstPlayerRank, layout.playerRanks, layout.players);
 }
 
-int getDistanceBetweenPoints(int x1, int y1, int x2, int y2) {
-    int horizontalDistance = abs(x1 - x2);
-    int verticalDistance = abs(y1 - y2);
-    return horizontalDistance + verticalDistance;
+int getHostedPlayerCount(int rank) {
+    return hostsPlayers(rank) ? getFirstPlayer(rank + 1) - getFirstPlayer(rank) : 0;
 }
 
-int bothPointsInRange(int x1, int y1, int x2, int y2, int distance) {
-    return getDistanceBetweenPoints(x1, y1, x2, y2) <= distance ? TRUE : FALSE;
+int getPlayerRank(int index) {
+    return layout.firstPlayerRank + getBlockOwner(index, layout.playerRanks, layout.players);
 }
 
-int getScoringDirection(Player *player, int round) {
-    int scoreDirectionA = round < ROUNDS / 2 ? RIGHT : LEFT;
-    int scoreDirectionB = scoreDirectionA == RIGHT ? LEFT : RIGHT;
-    return player->team == TEAM_A ? scoreDirectionA : scoreDirectionB;
+int hostsPlayer(Hosted *hosted, int index) {
+    return index >= hosted->firstPlayer && index < hosted->firstPlayer + hosted->count ? TRUE : FALSE;
 }
 
-int getMin(int value1, int value2) {
-    return value2 < value1 ? value2 : value1;
+int playerIsInField(Field *field, int index) {
+    return
+        field->players[index].currX != DO_NOT_EXIST &&
+        field->players[index].currY != DO_NOT_EXIST ? TRUE : FALSE;
 }
 
-int goalScored(Ball *ball, Player *player, int round) {
-    // For now ignore own goals, should not happen anyway
-    int scoringDirection = getScoringDirection(player, round);
-    int scoredAtLeft = 
-        ball->x < GOAL_LEFT_START_X && 
-        ball->y >= GOAL_LEFT_START_Y && 
-        ball->y <= GOAL_LEFT_END_Y;
-    int scoredAtRight =
-        ball->x > GOAL_RIGHT_START_X &&
-        ball->y >= GOAL_RIGHT_START_Y && 
-        ball->y <= GOAL_RIGHT_END_Y;
+int ballIsInField(Field *field) {
+    return field->ball->x != DO_NOT_EXIST && field->ball->y != DO_NOT_EXIST ? TRUE : FALSE;
+}
 
-    return scoredAtLeft || scoredAtRight ? TRUE : FALSE;
+Ball *getHostedBall(Hosted *hosted) {
+    // At most one hosted subfield holds the ball
+    int t;
+    for (t = 0; t < hosted->tiles; t++) {
+        if (ballIsInField(&hosted->fields[t])) {
+            return hosted->fields[t].ball;
+        }
+    }
+    return NULL;
 }
 
 /* ====================== INIT ======================*/
-void initField(int rank, Field *field) {
-    // Initialize ball position in the center at (64, 48)
-    int fieldRank = getFieldRankFromCoords(FIELD_LENGTH / 2, FIELD_WIDTH / 2);
-    if (rank == fieldRank) {
-        field->ball.x = FIELD_LENGTH / 2;
-        field->ball.y = FIELD_WIDTH / 2;
+size_t getTileBytes() {
+    return sizeof(Ball) + layout.players * sizeof(Player);
+}
+
+void attachField(Field *field, char *block) {
+    field->ball = (Ball *) block;
+    field->players = (Player *) (block + sizeof(Ball));
+}
+
+void initField(int tile, Field *field) {
+    // Initialize ball position in the center, (64, 48) on the default pitch
+    int fieldRank = getFieldRankFromCoords(matchConfig.fieldLength / 2, matchConfig.fieldWidth / 2);
+    if (tile == fieldRank) {
+        field->ball->x = matchConfig.fieldLength / 2;
+        field->ball->y = matchConfig.fieldWidth / 2;
     } else {
-        field->ball.x = DO_NOT_EXIST;
-        field->ball.y = DO_NOT_EXIST;
+        field->ball->x = DO_NOT_EXIST;
+        field->ball->y = DO_NOT_EXIST;
     }
 
     // Initialize all player positions to DO_NOT_EXIST
     int p;
-    for (p = 0; p < PLAYERS; p++) {
+    for (p = 0; p < layout.players; p++) {
         field->players[p].prevX = DO_NOT_EXIST;
         field->players[p].prevY = DO_NOT_EXIST;
         field->players[p].currX = DO_NOT_EXIST;
@@ -159,171 +442,434 @@ void initField(int rank, Field *field) {
     }
 }
 
-void initPlayer(int rank, Player *player) {
-    // Initialize player positions randomly
-    player->currX = player->prevX = rand() % FIELD_LENGTH;
-    player->currY = player->prevY = rand() % FIELD_WIDTH;
-    player->team = isTeamA(rank) ? TEAM_A : TEAM_B;
-    player->reached = PLAYER_NO_REACHED_BALL;
-    player->kicked = PLAYER_NO_KICKED_BALL;
-    player->challenge = PLAYER_NO_CHALLENGE;
+void initHosted(int rank, int firstTile, Hosted *hosted, char *storage, uint64_t seed) {
+    // Subfields live in the given storage, or in a private block without one
+    int t, i;
+    hosted->firstTile = firstTile;
+    hosted->tiles = getTileCount(rank);
+    hosted->ownsStorage = storage == NULL ? TRUE : FALSE;
+    hosted->storage = storage != NULL ? storage : allocOrAbort((hosted->tiles > 0 ? hosted->tiles : 1) * getTileBytes());
+    hosted->fields = allocOrAbort((hosted->tiles > 0 ? hosted->tiles : 1) * sizeof(Field));
+    for (t = 0; t < hosted->tiles; t++) {
+        attachField(&hosted->fields[t], hosted->storage + t * getTileBytes());
+        initField(firstTile + t, &hosted->fields[t]);
+    }
 
-    // Initialize player stats randomly
-    player->speed = player->dribble = player->kick = 1;
+    hosted->firstPlayer = hostsPlayers(rank) ? getFirstPlayer(rank) : 0;
+    hosted->count = getHostedPlayerCount(rank);
+    hosted->players = allocOrAbort((hosted->count > 0 ? hosted->count : 1) * sizeof(Player));
+    for (i = 0; i < hosted->count; i++) {
+        initPlayerState(hosted->firstPlayer + i, &hosted->players[i], seed);
+    }
+}
 
-    int stats = PLAYER_ALL_MAX;
-    stats -= (player->speed + player->dribble + player->kick);
-    int increment;
-    increment = rand() % PLAYER_STAT_MAX;
-    player->speed += increment;
-    stats -= increment;
-    increment = rand() % stats;
-    player->dribble += increment;
-    stats -= increment;
-    player->kick += stats;
+void rehostTiles(Hosted *hosted, int firstTile, int tiles, char *storage) {
+    // Takes over subfields whose blocks already sit in the given private storage
+    int t;
+    free(hosted->storage);
+    free(hosted->fields);
+    hosted->firstTile = firstTile;
+    hosted->tiles = tiles;
+    hosted->storage = storage;
+    hosted->fields = allocOrAbort((tiles > 0 ? tiles : 1) * sizeof(Field));
+    for (t = 0; t < tiles; t++) {
+        attachField(&hosted->fields[t], storage + t * getTileBytes());
+    }
 }
 
-void printField(int rank, Field *field) {
-    if (isField(rank)) {
-        if (ballIsInField(field)) {
-            printf("[Process %d] Ball position: (%d, %d)\n", rank, field->ball.x, field->ball.y);
-        }
-        int p;
-        for (p = 0; p < PLAYERS; p++) {
-            int playerRank = p + FIELDS;
-            if (playerIsInField(field, playerRank)) {
-                printf("[Process %d] Player %d position: (%d, %d) => (%d, %d), team %d, reached=%d, kicked=%d, challenge=%d, speed=%d, dribble=%d, kick=%d\n", 
-                rank, playerRank, 
-                field->players[p].prevX, field->players[p].prevY,
-                field->players[p].currX, field->players[p].currY, 
-                field->players[p].team, field->players[p].reached, 
-                field->players[p].kicked, field->players[p].challenge, 
-                field->players[p].speed, field->players[p].dribble, field->players[p].kick);
-            }
+void freeHosted(Hosted *hosted) {
+    if (hosted->ownsStorage) {
+        free(hosted->storage);
+    }
+    free(hosted->fields);
+    free(hosted->players);
+}
+
+void printField(int tile, Field *field) {
+    if (ballIsInField(field)) {
+        printf("[Subfield %d] Ball position: (%d, %d)\n", tile, field->ball->x, field->ball->y);
+    }
+    int p;
+    for (p = 0; p < layout.players; p++) {
+        if (playerIsInField(field, p)) {
+            printf("[Subfield %d] Player %d position: (%d, %d) => (%d, %d), team %d, reached=%d, kicked=%d, challenge=%d, speed=%d, dribble=%d, kick=%d\n",
+            tile, p,
+            field->players[p].prevX, field->players[p].prevY,
+            field->players[p].currX, field->players[p].currY,
+            field->players[p].team, field->players[p].reached,
+            field->players[p].kicked, field->players[p].challenge,
+            field->players[p].speed, field->players[p].dribble, field->players[p].kick);
         }
     }
 }
 
+/* ================== WIRE CODEC ==================*/
+void initWire(int compact, Hosted *hosted) {
+    // The hosted stats go out once, every later message only carries round state
+    int r, i;
+    wire.compact = compact;
+    if (!compact) {
+        return;
+    }
+    wire.stats = allocOrAbort(layout.players * sizeof(uint32_t));
+    wire.hostedWords = allocOrAbort((hosted->count > 0 ? hosted->count : 1) * sizeof(uint64_t));
+    wire.words = allocOrAbort(layout.players * sizeof(uint64_t));
+
+    uint32_t *hostedStats = allocOrAbort((hosted->count > 0 ? hosted->count : 1) * sizeof(uint32_t));
+    int *counts = allocOrAbort(layout.procs * sizeof(int));
+    int *displacements = allocOrAbort(layout.procs * sizeof(int));
+    for (i = 0; i < hosted->count; i++) {
+        hostedStats[i] = packPlayerStats(&hosted->players[i]);
+    }
+    for (r = 0; r < layout.procs; r++) {
+        counts[r] = getHostedPlayerCount(r);
+        displacements[r] = hostsPlayers(r) ? getFirstPlayer(r) : 0;
+    }
+    MPI_Allgatherv(hostedStats, hosted->count, MPI_UINT32_T, wire.stats, counts, displacements, MPI_UINT32_T,
+        tournament.comm);
+    free(hostedStats);
+    free(counts);
+    free(displacements);
+}
+
+void freeWire() {
+    if (wire.compact) {
+        free(wire.stats);
+        free(wire.hostedWords);
+        free(wire.words);
+    }
+}
+
+void packHostedPlayers(Hosted *hosted) {
+    int i;
+    for (i = 0; i < hosted->count; i++) {
+        wire.hostedWords[i] = packPlayerWord(&hosted->players[i]);
+    }
+}
+
+void unpackPlayer(int index, uint64_t word, Player *player) {
+    unpackPlayerWord(word, wire.stats[index], player);
+}
+
+uint64_t packBallWord(Ball *ball) {
+    // Both coordinates shifted by one, so a missing ball packs to zero
+    return ball != NULL ? (uint64_t) (ball->x + 1) | (uint64_t) (ball->y + 1) << 32 : 0;
+}
+
+void unpackBallWord(uint64_t word, int position[2]) {
+    position[0] = (int) (word & 0xFFFFFFFF) - 1;
+    position[1] = (int) (word >> 32) - 1;
+}
+
 /* ================ COLLECTIVE FUNCTIONS ================*/
-void updatePlayerPositions(int rank, Field *field, Ball *ball, Player *player) {
-    int newPosition[4];
+MPI_Datatype playerType;
+
+void createPlayerType() {
+    // Every member of Player is an int, so describe the struct as one block of ints and
+    // resize it to the struct extent so arrays of Player can be sent directly
+    int blockLength = sizeof(Player) / sizeof(int);
+    MPI_Aint displacement = 0;
+    MPI_Datatype type = MPI_INT;
+    MPI_Datatype structType;
+
+    MPI_Type_create_struct(1, &blockLength, &displacement, &type, &structType);
+    MPI_Type_create_resized(structType, 0, sizeof(Player), &playerType);
+    MPI_Type_commit(&playerType);
+    MPI_Type_free(&structType);
+}
+
+MPI_Datatype kickClaimType;
+MPI_Op kickClaimOp;
+
+void reduceKickClaims(void *in, void *inout, int *length, MPI_Datatype *type) {
+    KickClaim *claims = (KickClaim *) in;
+    KickClaim *best = (KickClaim *) inout;
+
+    int i;
+    for (i = 0; i < *length; i++) {
+        if (kickClaimBeats(&claims[i], &best[i])) {
+            best[i] = claims[i];
+        }
+    }
+}
+
+void createKickClaimOp() {
+    // The claim ordering is total, so the reduction is commutative
+    MPI_Type_contiguous(sizeof(KickClaim) / sizeof(int), MPI_INT, &kickClaimType);
+    MPI_Type_commit(&kickClaimType);
+    MPI_Op_create(reduceKickClaims, TRUE, &kickClaimOp);
+}
+
+void initRoundCollectives(RoundCollectives *collectives, Hosted *hosted, Player *players,
+    MPI_Comm gatherComm) {
+    // Processes without players contribute nothing, the others fill the slots of the
+    // players they host. Processes outside gatherComm take no part in the player gather
+    int r, size = 0;
+    int block[2] = {hosted->count, hosted->firstPlayer};
+    int *blocks = allocOrAbort(2 * layout.procs * sizeof(int));
+    if (gatherComm != MPI_COMM_NULL) {
+        MPI_Comm_size(gatherComm, &size);
+        MPI_Allgather(block, 2, MPI_INT, blocks, 2, MPI_INT, gatherComm);
+    }
+    collectives->gatherComm = gatherComm;
+    collectives->playerCounts = allocOrAbort(layout.procs * sizeof(int));
+    collectives->playerDisplacements = allocOrAbort(layout.procs * sizeof(int));
+    for (r = 0; r < size; r++) {
+        collectives->playerCounts[r] = blocks[2 * r];
+        collectives->playerDisplacements[r] = blocks[2 * r + 1];
+    }
+    free(blocks);
+    collectives->player = hosted->players;
+    collectives->players = players;
+    collectives->fieldBalls = allocOrAbort(layout.fieldRanks * sizeof(int[2]));
+    collectives->kickedBalls = allocOrAbort(layout.playerRanks * sizeof(int[2]));
+    collectives->fieldBallRequests = allocOrAbort(layout.fieldRanks * sizeof(MPI_Request));
+    collectives->kickedBallRequests = allocOrAbort(layout.playerRanks * sizeof(MPI_Request));
+
+#ifdef PERSISTENT_COLLECTIVES
+    collectives->playerRequest = MPI_REQUEST_NULL;
+    if (gatherComm != MPI_COMM_NULL && wire.compact) {
+        MPI_Allgatherv_init(wire.hostedWords, hosted->count, MPI_UINT64_T, wire.words, collectives->playerCounts,
+            collectives->playerDisplacements, MPI_UINT64_T, gatherComm, MPI_INFO_NULL, &collectives->playerRequest);
+    } else if (gatherComm != MPI_COMM_NULL) {
+        MPI_Allgatherv_init(hosted->players, hosted->count, playerType, players, collectives->playerCounts,
+            collectives->playerDisplacements, playerType, gatherComm, MPI_INFO_NULL, &collectives->playerRequest);
+    }
+    MPI_Allreduce_init(&collectives->claim, &collectives->winner, 1, kickClaimType, kickClaimOp,
+        tournament.comm, MPI_INFO_NULL, &collectives->claimRequest);
+    int f, p;
+    for (f = 0; f < layout.fieldRanks; f++) {
+        MPI_Bcast_init(collectives->fieldBalls[f], 2, MPI_INT, f, tournament.comm, MPI_INFO_NULL,
+            &collectives->fieldBallRequests[f]);
+    }
+    for (p = 0; p < layout.playerRanks; p++) {
+        MPI_Bcast_init(collectives->kickedBalls[p], 2, MPI_INT, layout.firstPlayerRank + p, tournament.comm,
+            MPI_INFO_NULL, &collectives->kickedBallRequests[p]);
+    }
+    MPI_Barrier_init(tournament.comm, MPI_INFO_NULL, &collectives->barrierRequest);
+#endif
+}
+
+void freeRoundCollectives(RoundCollectives *collectives) {
+#ifdef PERSISTENT_COLLECTIVES
+    int f, p;
+    if (collectives->playerRequest != MPI_REQUEST_NULL) {
+        MPI_Request_free(&collectives->playerRequest);
+    }
+    MPI_Request_free(&collectives->claimRequest);
+    for (f = 0; f < layout.fieldRanks; f++) {
+        MPI_Request_free(&collectives->fieldBallRequests[f]);
+    }
+    for (p = 0; p < layout.playerRanks; p++) {
+        MPI_Request_free(&collectives->kickedBallRequests[p]);
+    }
+    MPI_Request_free(&collectives->barrierRequest);
+#endif
+    free(collectives->playerCounts);
+    free(collectives->playerDisplacements);
+    free(collectives->fieldBalls);
+    free(collectives->kickedBalls);
+    free(collectives->fieldBallRequests);
+    free(collectives->kickedBallRequests);
+}
+
+void startPlayerGather(RoundCollectives *collectives, Hosted *hosted) {
+    if (collectives->gatherComm == MPI_COMM_NULL) {
+        collectives->playerRequest = MPI_REQUEST_NULL;
+        return;
+    }
+    if (wire.compact) {
+        packHostedPlayers(hosted);
+    }
+#ifdef PERSISTENT_COLLECTIVES
+    MPI_Start(&collectives->playerRequest);
+#else
+    if (wire.compact) {
+        MPI_Iallgatherv(wire.hostedWords, hosted->count, MPI_UINT64_T, wire.words,
+            collectives->playerCounts, collectives->playerDisplacements, MPI_UINT64_T, collectives->gatherComm,
+            &collectives->playerRequest);
+    } else {
+        MPI_Iallgatherv(collectives->player, hosted->count, playerType, collectives->players,
+            collectives->playerCounts, collectives->playerDisplacements, playerType, collectives->gatherComm,
+            &collectives->playerRequest);
+    }
+#endif
+}
 
+void finishPlayerGather(RoundCollectives *collectives) {
+    // Processes outside the gather read the records their leader unpacked
     int p;
-    for (p = 0; p < PLAYERS; p++) {
-        int root = p + FIELDS;
-        if (!isField(rank)) {
-            newPosition[0] = player->prevX;
-            newPosition[1] = player->prevY;
-            newPosition[2] = player->currX;
-            newPosition[3] = player->currY;
-        }
-
-        MPI_Bcast(&newPosition, 4, MPI_INT, root, MPI_COMM_WORLD);
-        if (isField(rank)) {
-            // printf("field process %d received (%d, %d) from %d\n", rank, newPosition[0], newPosition[1], root);
-            // For every field process, check if the root player process already exists
-            // in the current field process
-            if (playerIsInField(field, root)) {
+    MPI_Wait(&collectives->playerRequest, MPI_STATUS_IGNORE);
+    if (wire.compact && collectives->gatherComm != MPI_COMM_NULL) {
+        for (p = 0; p < layout.players; p++) {
+            unpackPlayer(p, wire.words[p], &collectives->players[p]);
+        }
+    }
+}
+
+void startClaimReduction(RoundCollectives *collectives) {
+#ifdef PERSISTENT_COLLECTIVES
+    MPI_Start(&collectives->claimRequest);
+#else
+    MPI_Iallreduce(&collectives->claim, &collectives->winner, 1, kickClaimType, kickClaimOp,
+        tournament.comm, &collectives->claimRequest);
+#endif
+}
+
+void startFieldBallBroadcasts(RoundCollectives *collectives) {
+#ifdef PERSISTENT_COLLECTIVES
+    MPI_Startall(layout.fieldRanks, collectives->fieldBallRequests);
+#else
+    int f;
+    for (f = 0; f < layout.fieldRanks; f++) {
+        MPI_Ibcast(collectives->fieldBalls[f], 2, MPI_INT, f, tournament.comm, &collectives->fieldBallRequests[f]);
+    }
+#endif
+}
+
+void startKickedBallBroadcast(RoundCollectives *collectives, int playerRank) {
+    // Slot k belongs to the k-th process hosting players
+    int slot = playerRank - layout.firstPlayerRank;
+#ifdef PERSISTENT_COLLECTIVES
+    MPI_Start(&collectives->kickedBallRequests[slot]);
+#else
+    MPI_Ibcast(collectives->kickedBalls[slot], 2, MPI_INT, playerRank, tournament.comm,
+        &collectives->kickedBallRequests[slot]);
+#endif
+}
+
+void waitBarrier(RoundCollectives *collectives) {
+#ifdef PERSISTENT_COLLECTIVES
+    MPI_Start(&collectives->barrierRequest);
+    MPI_Wait(&collectives->barrierRequest, MPI_STATUS_IGNORE);
+#else
+    MPI_Barrier(tournament.comm);
+#endif
+}
+
+void gatherPlayers(RoundCollectives *collectives, Hosted *hosted) {
+    startPlayerGather(collectives, hosted);
+    finishPlayerGather(collectives);
+}
+
+void updatePlayerPositions(Hosted *hosted, Player *players) {
+    int t, p;
+    for (t = 0; t < hosted->tiles; t++) {
+        Field *field = &hosted->fields[t];
+        for (p = 0; p < layout.players; p++) {
+            // For every subfield, check if the player already exists in it
+            if (playerIsInField(field, p)) {
                 field->players[p].currX = DO_NOT_EXIST;
                 field->players[p].currY = DO_NOT_EXIST;
             }
 
-            // Ignore the broadcast if the position sent is not within this field
-            int fieldRank = getFieldRankFromCoords(newPosition[0], newPosition[1]);
-            if (rank == fieldRank) {
-                field->players[p].prevX = newPosition[0];
-                field->players[p].prevY = newPosition[1];
-                field->players[p].currX = newPosition[2];
-                field->players[p].currY = newPosition[3];
-                // printf("field process %d player %d (%d, %d) => (%d, %d)\n", rank, root, field->players[p].prevX, field->players[p].prevY, field->players[p].currX, field->players[p].currY);
+            // Ignore the record if the position sent is not within this subfield
+            int fieldRank = getFieldRankFromCoords(players[p].prevX, players[p].prevY);
+            if (hosted->firstTile + t == fieldRank) {
+                field->players[p].prevX = players[p].prevX;
+                field->players[p].prevY = players[p].prevY;
+                field->players[p].currX = players[p].currX;
+                field->players[p].currY = players[p].currY;
             }
         }
     }
 }
 
-void updatePlayerData(int rank, Field *field, Ball *ball, Player *player) {
-    int newData[7];
-
-    int p;
-    for (p = 0; p < PLAYERS; p++) {
-        int root = p + FIELDS;
-        if (!isField(rank)) {
-            newData[0] = player->team;
-            newData[1] = player->reached;
-            newData[2] = player->kicked;
-            newData[3] = player->challenge;
-            newData[4] = player->speed;
-            newData[5] = player->dribble;
-            newData[6] = player->kick;
-        }
-
-        MPI_Bcast(&newData, 7, MPI_INT, root, MPI_COMM_WORLD);
-        if (isField(rank)) {
-            if (playerIsInField(field, root)) {
-                field->players[p].team = newData[0];
-                field->players[p].reached = newData[1];
-                field->players[p].kicked = newData[2];
-                field->players[p].challenge = newData[3];
-                field->players[p].speed = newData[4];
-                field->players[p].dribble = newData[5];
-                field->players[p].kick = newData[6];
+void updatePlayerData(Hosted *hosted, Player *players) {
+    int t, p;
+    for (t = 0; t < hosted->tiles; t++) {
+        Field *field = &hosted->fields[t];
+        for (p = 0; p < layout.players; p++) {
+            if (playerIsInField(field, p)) {
+                field->players[p].team = players[p].team;
+                field->players[p].reached = players[p].reached;
+                field->players[p].kicked = players[p].kicked;
+                field->players[p].challenge = players[p].challenge;
+                field->players[p].speed = players[p].speed;
+                field->players[p].dribble = players[p].dribble;
+                field->players[p].kick = players[p].kick;
             }
         }
     }
 }
 
-void updateBallPosition(int rank, Field *field, Ball *ball, Player *player) {
-    int newPosition[2];
+void placeBall(int tile, Field *field, int newPosition[2]) {
+    // For every subfield, check if the ball location is already defined there
+    if (ballIsInField(field)) {
+        field->ball->x = DO_NOT_EXIST;
+        field->ball->y = DO_NOT_EXIST;
+    }
+
+    // Ignore the broadcast if the new ball position is not within this subfield
+    int fieldRank = getFieldRankFromCoords(newPosition[0], newPosition[1]);
+    if (tile == fieldRank) {
+        field->ball->x = newPosition[0];
+        field->ball->y = newPosition[1];
+        // printf("ball is now in subfield %d at (%d, %d)\n", tile, field->ball->x, field->ball->y);
+    }
+}
+
+void placeHostedBall(Hosted *hosted, int newPosition[2]) {
+    int t;
+    for (t = 0; t < hosted->tiles; t++) {
+        placeBall(hosted->firstTile + t, &hosted->fields[t], newPosition);
+    }
+}
+
+int hostsKicker(Hosted *hosted) {
+    int i;
+    for (i = 0; i < hosted->count; i++) {
+        if (hosted->players[i].kicked == PLAYER_KICKED_BALL) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
 
+void updateBallPosition(int rank, Hosted *hosted, Ball *ball, RoundCollectives *collectives) {
+    // Every process hosting players broadcasts once for all of them, only the one hosting
+    // the kicker sends a position
     int p;
-    for (p = 0; p < PLAYERS; p++) {
-        int root = p + FIELDS;
-        if (!isField(rank) && player->kicked == PLAYER_KICKED_BALL) {
+    for (p = 0; p < layout.playerRanks; p++) {
+        int *newPosition = collectives->kickedBalls[p];
+        if (rank == layout.firstPlayerRank + p && hostsKicker(hosted)) {
             newPosition[0] = ball->x;
             newPosition[1] = ball->y;
         } else {
             newPosition[0] = DO_NOT_EXIST;
             newPosition[1] = DO_NOT_EXIST;
         }
+        startKickedBallBroadcast(collectives, layout.firstPlayerRank + p);
+    }
+    MPI_Waitall(layout.playerRanks, collectives->kickedBallRequests, MPI_STATUSES_IGNORE);
 
-        MPI_Bcast(&newPosition, 2, MPI_INT, root, MPI_COMM_WORLD);
+    for (p = 0; p < layout.playerRanks; p++) {
+        int *newPosition = collectives->kickedBalls[p];
 
         // Ignore broadcasts from players that did not kick the ball
         if (newPosition[0] != DO_NOT_EXIST && newPosition[1] != DO_NOT_EXIST) {
-            if (isField(rank)) {
-                // For every field process, check if the ball location is already defined there
-                if (ballIsInField(field)) {
-                    field->ball.x = DO_NOT_EXIST;
-                    field->ball.y = DO_NOT_EXIST;
-                }
-
-                // Ignore the broadcast if the new ball position is not within this field
-                int fieldRank = getFieldRankFromCoords(newPosition[0], newPosition[1]);
-                if (rank == fieldRank) {
-                    field->ball.x = newPosition[0];
-                    field->ball.y = newPosition[1];
-                    // printf("ball is now in field process %d at (%d, %d)\n", rank, field->ball.x, field->ball.y);
-                }
-            }
+            placeHostedBall(hosted, newPosition);
         }
     }
 }
 
-void broadcastBallPosition(int rank, Field *field, Ball *ball, Player *player) {
-    int ballPosition[2];
+void broadcastBallPosition(int rank, Hosted *hosted, Ball *ball, RoundCollectives *collectives) {
+    // Every field process broadcasts its ball position, only one of them holds the ball
+    if (isField(rank)) {
+        Ball *hostedBall = getHostedBall(hosted);
+        collectives->fieldBalls[rank][0] = hostedBall != NULL ? hostedBall->x : DO_NOT_EXIST;
+        collectives->fieldBalls[rank][1] = hostedBall != NULL ? hostedBall->y : DO_NOT_EXIST;
+    }
+    startFieldBallBroadcasts(collectives);
+    MPI_Waitall(layout.fieldRanks, collectives->fieldBallRequests, MPI_STATUSES_IGNORE);
 
     int f;
-    for (f = 0; f < FIELDS; f++) {
-        if (isField(rank)) {
-            ballPosition[0] = field->ball.x;
-            ballPosition[1] = field->ball.y;
-        }
-
-        MPI_Bcast(&ballPosition, 2, MPI_INT, f, MPI_COMM_WORLD);
+    for (f = 0; f < layout.fieldRanks; f++) {
+        int *ballPosition = collectives->fieldBalls[f];
 
         // Only update ball position for players if not DO_NOT_EXIST
-        if (!isField(rank)) {
-            if (ballPosition[0] != DO_NOT_EXIST && 
+        if (hostsPlayers(rank)) {
+            if (ballPosition[0] != DO_NOT_EXIST &&
                 ballPosition[1] != DO_NOT_EXIST) {
                 ball->x = ballPosition[0];
                 ball->y = ballPosition[1];
@@ -333,388 +879,2188 @@ void broadcastBallPosition(int rank, Field *field, Ball *ball, Player *player) {
     }
 }
 
-void determineKicker(int rank, Field *field, Ball *ball, Player *player) {
-    int challenge[PLAYERS];
-    int selectedKicker = DO_NOT_EXIST;
+void makeHostedKickClaim(Hosted *hosted, int round, uint64_t seed, KickClaim *claim) {
+    // The hosted players settle their claims locally, only the best one takes part in the
+    // reduction
+    claim->challenge = PLAYER_NO_CHALLENGE;
+    claim->key = 0;
+    claim->player = DO_NOT_EXIST;
+    claim->x = DO_NOT_EXIST;
+    claim->y = DO_NOT_EXIST;
+
+    int i;
+    for (i = 0; i < hosted->count; i++) {
+        KickClaim own;
+        makeKickClaim(hosted->firstPlayer + i, &hosted->players[i], round, seed, &own);
+        if (kickClaimBeats(&own, claim)) {
+            *claim = own;
+        }
+    }
+}
 
-    // Determine the ball challenge
-    if (!isField(rank) && player->reached == PLAYER_REACHED_BALL) {
-        player->challenge = (1 + rand() % 10) * player->dribble;
+void markHostedKicker(Hosted *hosted, KickClaim *winner) {
+    if (winner->challenge != PLAYER_NO_CHALLENGE && hostsPlayer(hosted, winner->player)) {
+        hosted->players[winner->player - hosted->firstPlayer].kicked = PLAYER_KICKED_BALL;
     }
+}
+
+void determineKicker(Hosted *hosted, int round, uint64_t seed, RoundCollectives *collectives) {
+    makeHostedKickClaim(hosted, round, seed, &collectives->claim);
+
+    // Every process learns the winning claim from one reduction
+    startClaimReduction(collectives);
+    MPI_Wait(&collectives->claimRequest, MPI_STATUS_IGNORE);
+    markHostedKicker(hosted, &collectives->winner);
+}
+
+int isTeammate(int index, int other) {
+    return (index < matchConfig.playersPerTeam) == (other < matchConfig.playersPerTeam) ? TRUE : FALSE;
+}
 
+void indexPlayers(Hosted *hosted, Player *players, PassIndex *passIndex) {
+    // Every process already holds the gathered player records, so the one hosting the
+    // kicker only relinks the players that changed cells since its last kick
     int p;
-    for (p = 0; p < PLAYERS; p++) {
-        int root = p + FIELDS;
-        if (!isField(rank)) {
-            challenge[p] = player->challenge;
-        }
-
-        // Broadcast all the players' ball challenges
-        MPI_Bcast(&challenge, PLAYERS, MPI_INT, root, MPI_COMM_WORLD);
-    }
-
-    // Only the field process with the ball handles the ball challenges
-    if (isField(rank) && ballIsInField(field)) {
-        // printf("ball is in field process %d\n", rank);
-        // printf("ball challenges: ");
-        // for (p = 0; p < PLAYERS; p++) {
-        //     printf("%d ", challenge[p]);
-        // }
-        // printf("\n");
-        int highestBallChallenge = 0;
-        for (p = 0; p < PLAYERS; p++) {
-            if (challenge[p] >= highestBallChallenge) {
-                if (challenge[p] == highestBallChallenge) {
-                    if (rand() % 11 > rand() % 11) {
-                        selectedKicker = p + FIELDS;
-                    }
-                } else {
-                    selectedKicker = p + FIELDS;
-                }
-                highestBallChallenge = challenge[p];
-            }
-        }
-        // printf("highest ball challenge=%d, selected kicker=player %d\n", highestBallChallenge, selectedKicker);
+    if (!hostsKicker(hosted)) {
+        return;
+    }
+    for (p = 0; p < layout.players; p++) {
+        placeInPassIndex(passIndex, p, players[p].currX, players[p].currY);
     }
+}
+
+void tallyKick(Result *result, int team, int outcome) {
+    // Same categories as match_ensemble, shots are kicks towards goal that stayed in the
+    // field and outs are kicks that left it
+    if (outcome == KICK_GOAL) {
+        result->goals[team]++;
+    } else if (outcome == KICK_PASS) {
+        result->passes[team]++;
+    } else if (outcome == KICK_TOWARDS_GOAL) {
+        result->shots[team]++;
+    } else if (outcome == KICK_OUT_OF_FIELD) {
+        result->outs[team]++;
+    }
+}
 
-    // Broadcast the selectedKicker to all players
-    int f, kicker;
-    for (f = 0; f < FIELDS; f++) {
-        kicker = selectedKicker;
-        MPI_Bcast(&kicker, 1, MPI_INT, f, MPI_COMM_WORLD);
-        if (!isField(rank) && rank == kicker) {
-            // printf("player %d selected as kicker\n", rank);
-            player->kicked = PLAYER_KICKED_BALL;
+void kickBall(Hosted *hosted, PassIndex *passIndex, Ball *ball, int round, uint64_t seed, Result *result) {
+    // The kicker only looks at the teammates around it in the pass index
+    int i;
+    for (i = 0; i < hosted->count; i++) {
+        Player *player = &hosted->players[i];
+        if (player->kicked == PLAYER_KICKED_BALL) {
+            int outcome = playerKickBallIndexed(hosted->firstPlayer + i, player, ball, passIndex, round, seed);
+            tallyKick(result, player->team, outcome);
         }
     }
 }
 
-void kickBall(int rank, Field *field, Ball *ball, Player *player, int round) {
-    // Get positions of all teammates
-    int positions[PLAYERS][2];
-    int p;
-    for (p = 0; p < PLAYERS; p++) {
-        int root = p + FIELDS;
-        if (!isField(rank)) {
-            positions[p][0] = player->currX;
-            positions[p][1] = player->currY;
-        }
-
-        MPI_Bcast(&positions[p], 2, MPI_INT, root, MPI_COMM_WORLD);
-    }
-
-    // Determine new ball position with priorities:
-    // 1. Score into goal
-    // 2. Kick to teammate within kick range
-    // 3. Kick towards goal
-    if (!isField(rank) && player->kicked == PLAYER_KICKED_BALL) {
-        // printf("player %d kicking ball\n", rank);
-        int kickRange = player->kick * 2;
-        int scoringDirection = getScoringDirection(player, round);
-        int goalStartX, goalStartY, goalEndX, goalEndY;
-
-        // Check if the goal is within kick range from current position
-        int scoreFromTopGoalPost, scoreFromBottomGoalPost;
-        if (scoringDirection == LEFT) {
-            scoreFromTopGoalPost = bothPointsInRange(ball->x, ball->y, GOAL_LEFT_START_X - 1, GOAL_LEFT_START_Y, kickRange);
-            scoreFromBottomGoalPost = bothPointsInRange(ball->x, ball->y, GOAL_LEFT_END_X - 1, GOAL_LEFT_END_Y, kickRange);
-        } else {
-            scoreFromTopGoalPost = bothPointsInRange(ball->x, ball->y, GOAL_RIGHT_START_X + 1, GOAL_RIGHT_START_Y, kickRange);
-            scoreFromBottomGoalPost = bothPointsInRange(ball->x, ball->y, GOAL_RIGHT_END_X + 1, GOAL_RIGHT_END_Y, kickRange);
-        }
-        // Count as goal and reposition ball to center of field
-        if (scoreFromTopGoalPost || scoreFromBottomGoalPost) {
-            ball->x = FIELD_LENGTH / 2;
-            ball->y = FIELD_WIDTH / 2;
-            // printf("player %d scored from (%d, %d) with kickrange=%d\n", rank, player->currX, player->currY, kickRange);
-            return;
-        }
-
-        // Search for a teammate to pass to
-        int teamStartIndex = player->team == TEAM_A ? 0 : PLAYERS_PER_TEAM;
-        int teamEndIndex = teamStartIndex + PLAYERS_PER_TEAM - 1;
-        for (p = teamStartIndex; p <= teamEndIndex; p++) {
-            // Ignore ownself
-            if (rank != p + FIELDS) {
-                int teammateX = positions[p][0];
-                int teammateY = positions[p][1];
-                // Check whether teammate or ownself is closer to goal, and only pass the ball
-                // to a teammate that is closer to the goal
-                if (bothPointsInRange(player->currX, player->currY, teammateX, teammateY, kickRange)) {
-                    if (scoringDirection == LEFT) {
-                        int teammateDistanceToTopGoalPost = getDistanceBetweenPoints(GOAL_LEFT_START_X, GOAL_LEFT_START_Y, teammateX, teammateY);
-                        int teammateDistanceToBottomGoalPost = getDistanceBetweenPoints(GOAL_LEFT_END_X, GOAL_LEFT_END_Y, teammateX, teammateY);
-                        int ownDistanceToTopGoalPost = getDistanceBetweenPoints(GOAL_LEFT_START_X, GOAL_LEFT_START_Y, player->currX, player->currY);
-                        int ownDistanceToBottomGoalPost = getDistanceBetweenPoints(GOAL_LEFT_END_X, GOAL_LEFT_END_Y, player->currX, player->currY);
-
-                        int teammateDistanceToGoal = getMin(teammateDistanceToTopGoalPost, teammateDistanceToBottomGoalPost);
-                        int ownDistanceToGoal = getMin(ownDistanceToTopGoalPost, ownDistanceToBottomGoalPost);
-                        if (teammateDistanceToGoal < ownDistanceToGoal) {
-                            ball->x = teammateX;
-                            ball->y = teammateY;
-                            // printf("scoring left: player %d (%d, %d) passed to player %d (%d, %d)\n", rank, player->currX, player->currY, p + FIELDS, teammateX, teammateY);
-                            return;
-                        }
-                    } else {
-                        int teammateDistanceToTopGoalPost = getDistanceBetweenPoints(GOAL_RIGHT_START_X, GOAL_RIGHT_START_Y, teammateX, teammateY);
-                        int teammateDistanceToBottomGoalPost = getDistanceBetweenPoints(GOAL_RIGHT_END_X, GOAL_RIGHT_END_Y, teammateX, teammateY);
-                        int ownDistanceToTopGoalPost = getDistanceBetweenPoints(GOAL_RIGHT_START_X, GOAL_RIGHT_START_Y, player->currX, player->currY);
-                        int ownDistanceToBottomGoalPost = getDistanceBetweenPoints(GOAL_RIGHT_END_X, GOAL_RIGHT_END_Y, player->currX, player->currY);
-
-                        int teammateDistanceToGoal = getMin(teammateDistanceToTopGoalPost, teammateDistanceToBottomGoalPost);
-                        int ownDistanceToGoal = getMin(ownDistanceToTopGoalPost, ownDistanceToBottomGoalPost);
-                        if (teammateDistanceToGoal < ownDistanceToGoal) {
-                            ball->x = teammateX;
-                            ball->y = teammateY;
-                            // printf("scoring right: player %d (%d, %d) passed to player %d (%d, %d)\n", rank, player->currX, player->currY, p + FIELDS, teammateX, teammateY);
-                            return;
-                        }
-                    }
+void initOutputGather(OutputGather *output) {
+    int f;
+    output->sendBuffer = allocOrAbort((2 + layout.players * 11) * sizeof(int));
+    output->receiveBuffer = allocOrAbort((layout.fieldRanks * 2 + layout.players * 11) * sizeof(int));
+    output->sendWords = allocOrAbort((1 + layout.players) * sizeof(uint64_t));
+    output->receiveWords = allocOrAbort((layout.fieldRanks + layout.players) * sizeof(uint64_t));
+    output->receiveCounts = allocOrAbort(layout.fieldRanks * sizeof(int));
+    output->displacements = allocOrAbort(layout.fieldRanks * sizeof(int));
+    output->owners = allocOrAbort(layout.players * sizeof(int));
+    output->sources = layout.fieldRanks;
+    output->sourceOf = allocOrAbort(layout.fieldRanks * sizeof(int));
+    for (f = 0; f < layout.fieldRanks; f++) {
+        output->sourceOf[f] = f;
+    }
+    output->owned = allocOrAbort(layout.players);
+    output->allOwned = allocOrAbort(layout.fieldRanks * layout.players);
+}
+
+void freeOutputGather(OutputGather *output) {
+    free(output->sendBuffer);
+    free(output->receiveBuffer);
+    free(output->sendWords);
+    free(output->receiveWords);
+    free(output->receiveCounts);
+    free(output->displacements);
+    free(output->owners);
+    free(output->sourceOf);
+    free(output->owned);
+    free(output->allOwned);
+}
+
+void postRoundOutput(Hosted *hosted, MPI_Comm comm, OutputGather *output, int round) {
+    // Every source sends its ball position followed by the records of the players its
+    // subfields own in player order, field process 0 already knows the owner of every
+    // player. On the compact wire both are one word each
+    int ballUnits = wire.compact ? 1 : 2;
+    int recordUnits = wire.compact ? 1 : 11;
+    int f, p, t;
+    for (f = 0; f < output->sources; f++) {
+        output->receiveCounts[f] = ballUnits;
+    }
+    for (p = 0; p < layout.players; p++) {
+        output->receiveCounts[output->owners[p]] += recordUnits;
+    }
+    output->displacements[0] = 0;
+    for (f = 1; f < output->sources; f++) {
+        output->displacements[f] = output->displacements[f - 1] + output->receiveCounts[f - 1];
+    }
+
+    int sendCount = ballUnits;
+    Ball *ball = getHostedBall(hosted);
+    if (wire.compact) {
+        output->sendWords[0] = packBallWord(ball);
+    } else {
+        output->sendBuffer[0] = ball != NULL ? ball->x : DO_NOT_EXIST;
+        output->sendBuffer[1] = ball != NULL ? ball->y : DO_NOT_EXIST;
+    }
+    for (p = 0; p < layout.players; p++) {
+        for (t = 0; t < hosted->tiles; t++) {
+            if (playerIsInField(&hosted->fields[t], p)) {
+                if (wire.compact) {
+                    output->sendWords[sendCount] = packPlayerWord(&hosted->fields[t].players[p]);
+                } else {
+                    packPlayerRecord(&hosted->fields[t].players[p], &output->sendBuffer[sendCount]);
                 }
+                sendCount += recordUnits;
             }
         }
+    }
 
-        // Kick the ball towards the goal
-        int horizontalDistance = rand() % (kickRange + 1);
-        int verticalDistance = kickRange - horizontalDistance;
-        ball->x = player->currX + (horizontalDistance * scoringDirection);
-        ball->y = player->currY + (verticalDistance * scoringDirection);
-
-        // Handle cases when ball is kicked out of field, reposition in center
-        if (ball->x < 0 || ball->x >= FIELD_LENGTH || ball->y < 0 || ball->y >= FIELD_WIDTH) {
-            // printf("ball kicked out of field (%d, %d), repositioning to center\n", ball->x, ball->y);
-            ball->x = FIELD_LENGTH / 2;
-            ball->y = FIELD_WIDTH / 2;
-        }
-        // printf("ball is now at (%d, %d)\n", ball->x, ball->y);
+    output->round = round;
+    if (wire.compact) {
+        MPI_Igatherv(output->sendWords, sendCount, MPI_UINT64_T, output->receiveWords, output->receiveCounts,
+            output->displacements, MPI_UINT64_T, 0, comm, &output->request);
+    } else {
+        MPI_Igatherv(output->sendBuffer, sendCount, MPI_INT, output->receiveBuffer, output->receiveCounts,
+            output->displacements, MPI_INT, 0, comm, &output->request);
     }
 }
 
-/* =============== PLAYER FUNCTIONS ================*/
-void clearPlayerRoundData(int rank, Player *player) {
-    if (!isField(rank)) {
-        player->reached = PLAYER_NO_REACHED_BALL;
-        player->kicked = PLAYER_NO_KICKED_BALL;
-        player->challenge = PLAYER_NO_CHALLENGE;
+void startRoundOutput(Hosted *hosted, Player *players, MPI_Comm comm, OutputGather *output, int round) {
+    // The owner of a player is the process hosting the subfield containing its previous
+    // position, which field process 0 derives from the gathered player records
+    int p;
+    for (p = 0; p < layout.players; p++) {
+        output->owners[p] = output->sourceOf[getOwnerRank(players[p].prevX, players[p].prevY)];
     }
+    postRoundOutput(hosted, comm, output, round);
 }
 
-void movePlayersTowardsBall(int rank, Ball *ball, Player *player) {
-    // Movement rules
-    // 1. Stop when ball is reached, or
-    // 2. Moved n squares, where n = speed skill
-    // 3. Always in the direction of the ball
-
-    if (!isField(rank)) {
-        // If the ball is within player->speed squares, move the player to the same square as the ball
-        if (bothPointsInRange(ball->x, ball->y, player->currX, player->currY, player->speed)) {
-            player->prevX = player->currX;
-            player->prevY = player->currY;
-            player->currX = ball->x;
-            player->currY = ball->y;
-            player->reached = 1;
-            return;
+void startOwnedOutput(Hosted *hosted, MPI_Comm comm, OutputGather *output, int round) {
+    // Without the gathered player records field process 0 does not know every owner, so
+    // each field tells it which players its subfields own
+    int f, p, t;
+    for (p = 0; p < layout.players; p++) {
+        output->owned[p] = FALSE;
+        for (t = 0; t < hosted->tiles; t++) {
+            if (playerIsInField(&hosted->fields[t], p)) {
+                output->owned[p] = TRUE;
+            }
+        }
+        output->owners[p] = 0;
+    }
+    MPI_Gather(output->owned, layout.players, MPI_CHAR, output->allOwned, layout.players, MPI_CHAR, 0, comm);
+    for (f = 0; f < output->sources; f++) {
+        for (p = 0; p < layout.players; p++) {
+            if (output->allOwned[f * layout.players + p]) {
+                output->owners[p] = f;
+            }
         }
+    }
+    postRoundOutput(hosted, comm, output, round);
+}
 
-        // Determine direction to travel towards ball, and move a random combined distance of
-        // player->speed squares in both directions
-        int horizontalDirection = (ball->x - player->currX) > 0 ? RIGHT : LEFT;
-        int verticalDirection = (ball->y - player->currY) > 0 ? UP : DOWN;
-        int horizontalDistance = rand() % (player->speed + 1);
-        int verticalDistance = player->speed - horizontalDistance;
-        player->prevX = player->currX;
-        player->prevY = player->currY;
-        player->currX += horizontalDistance * horizontalDirection;
-        player->currY += verticalDistance * verticalDirection;
+void finishRoundOutput(int rank, OutputGather *output, TraceWriter *trace) {
+    // A tournament match without a trace file still gathers, but keeps no rounds
+    MPI_Wait(&output->request, MPI_STATUS_IGNORE);
+    if (rank != 0 || trace == NULL) {
+        return;
+    }
 
-        // Make sure the player does not go out of bounds
-        if (player->currX < 0) {
-            player->currX = 0;
-        }
-        if (player->currY < 0) {
-            player->currY = 0;
-        }
-        if (player->currX >= FIELD_LENGTH) {
-            player->currX = FIELD_LENGTH - 1;
+    // The record is filled in place: round, ball position, then one row per player. Team A
+    // holds the lower player indices, so rows are in team order
+    int32_t *record = traceNextRecord(trace);
+    int *offsets = allocOrAbort(output->sources * sizeof(int));
+    int f, p;
+    record[0] = output->round;
+    for (f = 0; f < output->sources; f++) {
+        int ballPosition[2];
+        if (wire.compact) {
+            unpackBallWord(output->receiveWords[output->displacements[f]], ballPosition);
+            offsets[f] = output->displacements[f] + 1;
+        } else {
+            ballPosition[0] = output->receiveBuffer[output->displacements[f]];
+            ballPosition[1] = output->receiveBuffer[output->displacements[f] + 1];
+            offsets[f] = output->displacements[f] + 2;
         }
-        if (player->currY >= FIELD_WIDTH) {
-            player->currY = FIELD_WIDTH - 1;
+        if (ballPosition[0] != DO_NOT_EXIST && ballPosition[1] != DO_NOT_EXIST) {
+            record[1] = ballPosition[0];
+            record[2] = ballPosition[1];
         }
+    }
 
-        // printf("player %d (%d, %d) => (%d, %d) with speed=%d\n", rank, player->prevX, player->prevY, player->currX, player->currY, player->speed);
+    // Store each record directly into its row, compact records take the stats shared at
+    // start
+    for (p = 0; p < layout.players; p++) {
+        int *row = &record[TRACE_RECORD_HEADER_INTS + p * 11];
+        if (wire.compact) {
+            Player player;
+            unpackPlayer(p, output->receiveWords[offsets[output->owners[p]]], &player);
+            packPlayerRecord(&player, row);
+            offsets[output->owners[p]] += 1;
+        } else {
+            memcpy(row, &output->receiveBuffer[offsets[output->owners[p]]], 11 * sizeof(int));
+            offsets[output->owners[p]] += 11;
+        }
     }
+    free(offsets);
+    traceCommitRecord(trace);
 }
 
-/* ======================== MAIN =========================*/
-int main(int argc, char *argv[]) {
-    // MPI Initialization
-    int rank, p, commRank, commSize;
-
-    MPI_Init(&argc, &argv);
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    srand(time(0) + rank);
+void gatherRoundOutput(int rank, Hosted *hosted, Player *players, MPI_Comm comm,
+    OutputGather *output, int round, TraceWriter *trace) {
+    startRoundOutput(hosted, players, comm, output, round);
+    finishRoundOutput(rank, output, trace);
+}
 
-    // Split processes into appropriate communicators
-    MPI_Comm COMM;
-    if (isField(rank)) {
-        MPI_Comm_split(MPI_COMM_WORLD, COMM_FIELDS, rank, &COMM);
+/* ================ PIPELINED ROUND ================*/
+void exchangeRoundClaims(Hosted *hosted, Player *players, RoundCollectives *collectives) {
+    // Players make their claim right after moving, so the player gather and the claim
+    // reduction are independent and both can be in flight together
+    startPlayerGather(collectives, hosted);
+    startClaimReduction(collectives);
+    finishPlayerGather(collectives);
+    MPI_Wait(&collectives->claimRequest, MPI_STATUS_IGNORE);
+
+    // The kick is the only change to the records after the gather, so every process
+    // applies it to its own copy instead of gathering the players again
+    KickClaim *winner = &collectives->winner;
+    if (winner->challenge != PLAYER_NO_CHALLENGE) {
+        players[winner->player].kicked = PLAYER_KICKED_BALL;
+        markHostedKicker(hosted, winner);
     }
-    if (isTeamA(rank)) {
-        MPI_Comm_split(MPI_COMM_WORLD, COMM_A, rank, &COMM);
+}
+
+void startBallBroadcast(int rank, Ball *ball, RoundCollectives *collectives) {
+    // Only the kicker knows the new ball position but every process knows who kicked
+    KickClaim *winner = &collectives->winner;
+    if (winner->challenge == PLAYER_NO_CHALLENGE) {
+        return;
     }
-    if (isTeamB(rank)) {
-        MPI_Comm_split(MPI_COMM_WORLD, COMM_B, rank, &COMM);
+
+    int kickerRank = getPlayerRank(winner->player);
+    int *newPosition = collectives->kickedBalls[kickerRank - layout.firstPlayerRank];
+    if (rank == kickerRank) {
+        newPosition[0] = ball->x;
+        newPosition[1] = ball->y;
     }
+    startKickedBallBroadcast(collectives, kickerRank);
+}
 
-    MPI_Comm_rank(COMM, &commRank);
-    MPI_Comm_size(COMM, &commSize);
+void finishBallBroadcast(int rank, Hosted *hosted, Ball *ball, RoundCollectives *collectives) {
+    KickClaim *winner = &collectives->winner;
+    if (winner->challenge == PLAYER_NO_CHALLENGE) {
+        return;
+    }
 
-    // Initialize private data for each of the processes
-    Field field;
-    Player player;
-    Ball ball;
+    // A hybrid process needs the position both for its subfields and for its players
+    int slot = getPlayerRank(winner->player) - layout.firstPlayerRank;
+    int *newPosition = collectives->kickedBalls[slot];
+    MPI_Wait(&collectives->kickedBallRequests[slot], MPI_STATUS_IGNORE);
     if (isField(rank)) {
-        initField(rank, &field);
-    } else {
-        initPlayer(rank, &player);
+        placeHostedBall(hosted, newPosition);
     }
+    if (hostsPlayers(rank)) {
+        ball->x = newPosition[0];
+        ball->y = newPosition[1];
+    }
+}
 
-    // Wait for all initializations to finish
-    MPI_Barrier(MPI_COMM_WORLD);
-    // printField(rank, &field);
-
-    // Broadcast all player initial positions to subfields
-    updatePlayerPositions(rank, &field, &ball, &player);
-    updatePlayerData(rank, &field, &ball, &player);
-
-    // Run for n rounds
-    int r;
-    for (r = 0; r < ROUNDS; r++) {
-        clearPlayerRoundData(rank, &player);
-        broadcastBallPosition(rank, &field, &ball, &player);
-        movePlayersTowardsBall(rank, &ball, &player);
-
-        // Wait for all player movement to finish
-        MPI_Barrier(MPI_COMM_WORLD);
-        // printField(rank, &field);
-
-        // Update all the new player positions and round data
-        updatePlayerPositions(rank, &field, &ball, &player);
-        updatePlayerData(rank, &field, &ball, &player);
-
-        // Handle ball kick
-        determineKicker(rank, &field, &ball, &player);
-        kickBall(rank, &field, &ball, &player, r);
-        updateBallPosition(rank, &field, &ball, &player);
-
-        // Ensure field is updated before proceeding to next round
-        updatePlayerData(rank, &field, &ball, &player);
-        MPI_Barrier(MPI_COMM_WORLD);
-        // printField(rank, &field);
-
-        // Gather all the field data in field process 0 for output
-        if (isField(rank)) {
-            int ballPosition[2];
-            int data[TEAMS][PLAYERS_PER_TEAM][11];
-
-            // Gather all the player data for each field process
-            int sendBuffer[11];
-            int receiveBuffer[FIELDS * 11];
-            for (p = 0; p < PLAYERS; p++) {
-                sendBuffer[0] = field.players[p].prevX;
-                sendBuffer[1] = field.players[p].prevY;
-                sendBuffer[2] = field.players[p].currX;
-                sendBuffer[3] = field.players[p].currY;
-                sendBuffer[4] = field.players[p].team;
-                sendBuffer[5] = field.players[p].reached;
-                sendBuffer[6] = field.players[p].kicked;
-                sendBuffer[7] = field.players[p].challenge;
-                sendBuffer[8] = field.players[p].speed;
-                sendBuffer[9] = field.players[p].dribble;
-                sendBuffer[10] = field.players[p].kick;
-
-                MPI_Barrier(COMM);
-                MPI_Gather(sendBuffer, 11, MPI_INT, receiveBuffer, 11, MPI_INT, 0, COMM);
-
-                if (rank == 0) {
-                    int players[FIELDS][11];
-                    int i, row = 0, col = 0;
-                    for (i = 0; i < FIELDS * 11; i++) {
-                        players[row][col] = receiveBuffer[i];
-                        col++;
-                        if ((i + 1) % 11 == 0) {
-                            row++;
-                            col = 0;
-                        }
-                    }
-                    // printf("player %d\n", p);
-                    // for (row = 0; row < FIELDS; row++) {
-                    //     for (col = 0; col < 11; col++) {
-                    //         printf("%d ", players[row][col]);
-                    //     }
-                    //     printf("\n");
-                    // }
-                    int rowData[11];
-                    for (row = 0; row < FIELDS; row++) {
-                        int x = players[row][2];
-                        int y = players[row][3];
-                        if (x != DO_NOT_EXIST && y != DO_NOT_EXIST) {
-                            for (i = 0; i < 11; i++) {
-                                rowData[i] = players[row][i];
-                            }
-                            break;
-                        }
-                    }
-
-                    // Store the row (player data) into the organized array
-                    int team = rowData[4];
-                    for (col = 0; col < 11; col++) {
-                        data[team][p % 11][col] = rowData[col];
-                    }
-                }
+/* ================== LOCAL KICK ==================*/
+int determineLocalKicker(Hosted *hosted, Player *players, int round, uint64_t seed, KickClaim *winner) {
+    // Players only reach the ball where it lies, so the gathered records tell every process
+    // whether anyone kicks this round and which field process holds the ball. Only the
+    // processes hosting a player that reached it settle the claims, from the same records
+    int p, ballRank = DO_NOT_EXIST, hostsReached = FALSE;
+    for (p = 0; p < layout.players; p++) {
+        if (players[p].reached == PLAYER_REACHED_BALL) {
+            if (ballRank == DO_NOT_EXIST) {
+                ballRank = getOwnerRank(players[p].currX, players[p].currY);
+            }
+            if (hostsPlayer(hosted, p)) {
+                hostsReached = TRUE;
             }
+        }
+    }
 
-            // Gather all the ball position data from all field processes
-            int ballSendBuffer[2];
-            int ballReceiveBuffer[FIELDS * 2];
-            if (isField(rank)) {
-                ballSendBuffer[0] = field.ball.x;
-                ballSendBuffer[1] = field.ball.y;
-                MPI_Gather(ballSendBuffer, 2, MPI_INT, ballReceiveBuffer, 2, MPI_INT, 0, COMM);
-
-                if (rank == 0) {
-                    int i;
-                    for (i = 0; i < FIELDS * 2; i += 2) {
-                        int ballX = ballReceiveBuffer[i];
-                        int ballY = ballReceiveBuffer[i + 1];
-                        // printf("%d %d\n", ballX, ballY);
-                        if (ballX != DO_NOT_EXIST && ballY != DO_NOT_EXIST) {
-                            ballPosition[0] = ballX;
-                            ballPosition[1] = ballY;
-                            break;
-                        }
-                    }
-                }
+    winner->challenge = PLAYER_NO_CHALLENGE;
+    winner->key = 0;
+    winner->player = DO_NOT_EXIST;
+    if (!hostsReached) {
+        return ballRank;
+    }
+
+    // Claims of hosted players land in their records, the others are worked out on copies
+    for (p = 0; p < layout.players; p++) {
+        if (players[p].reached == PLAYER_REACHED_BALL) {
+            Player copy = players[p];
+            Player *player = hostsPlayer(hosted, p) ? &hosted->players[p - hosted->firstPlayer] : &copy;
+            KickClaim claim;
+            makeKickClaim(p, player, round, seed, &claim);
+            if (kickClaimBeats(&claim, winner)) {
+                *winner = claim;
             }
+        }
+    }
+    markHostedKicker(hosted, winner);
+    return ballRank;
+}
 
-            if (rank == 0) {
-                int t, i;
-                printf("%d\n", r);
-                printf("%d %d\n", ballPosition[0], ballPosition[1]);
-                for (t = 0; t < TEAMS; t++) {
-                    for (p = 0; p < PLAYERS_PER_TEAM; p++) {
-                        for (i = 0; i < 11; i++) {
-                            printf("%d ", data[t][p][i]);
-                        }
-                        printf("\n");
-                    }
-                }
-                printf("\n");
-            }            
+void publishKickedBall(int rank, Hosted *hosted, Ball *ball, int ballRank, MPI_Comm fieldComm) {
+    // Without a kick the ball stays where it is. Otherwise the field process that held it
+    // learns the new position from the kicker and passes it on to the other fields, players
+    // hear of it from the ball broadcast of the next round. The field communicator numbers
+    // field processes like the match communicator
+    int newPosition[2];
+    if (ballRank == DO_NOT_EXIST) {
+        return;
+    }
+    if (hostsKicker(hosted)) {
+        newPosition[0] = ball->x;
+        newPosition[1] = ball->y;
+        if (rank != ballRank) {
+            MPI_Send(newPosition, 2, MPI_INT, ballRank, TAG_KICKED_BALL, tournament.comm);
         }
+    } else if (rank == ballRank) {
+        MPI_Recv(newPosition, 2, MPI_INT, MPI_ANY_SOURCE, TAG_KICKED_BALL, tournament.comm, MPI_STATUS_IGNORE);
+    }
+    if (isField(rank)) {
+        MPI_Bcast(newPosition, 2, MPI_INT, ballRank, fieldComm);
+        placeHostedBall(hosted, newPosition);
     }
+}
 
-    MPI_Finalize();
+/* ================= HALO SCHEDULE =================*/
+int getDistanceToSubfield(int tile, int x, int y) {
+    // Shortest number of squares from a position to any square of the subfield
+    int numCols = getSubfieldColumns();
+    int left = (tile % numCols) * matchConfig.subfieldLength;
+    int bottom = (tile / numCols) * matchConfig.subfieldWidth;
+    int right = left + matchConfig.subfieldLength - 1;
+    int top = bottom + matchConfig.subfieldWidth - 1;
+    int dx = x < left ? left - x : x > right ? x - right : 0;
+    int dy = y < bottom ? bottom - y : y > top ? y - top : 0;
+    return dx + dy;
+}
 
-    return 0;
-}
\ No newline at end of file
+int getNeighbourIndex(Halo *halo, int tile) {
+    int n;
+    for (n = 0; n < halo->neighbours; n++) {
+        if (halo->neighbourTiles[n] == tile) {
+            return n;
+        }
+    }
+    return DO_NOT_EXIST;
+}
+
+const char *checkHaloLayout() {
+    // Returns NULL when the halo schedule can run the match
+    int shortestSide = getMin(matchConfig.subfieldLength, matchConfig.subfieldWidth);
+    if (layout.fieldRanks != layout.fields) {
+        return "the halo schedule needs one subfield per field process";
+    }
+    if (shortestSide < HALO_KICK_RANGE || shortestSide < PLAYER_STAT_MAX) {
+        return "the halo schedule needs subfields at least as wide as the longest kick";
+    }
+    return NULL;
+}
+
+void initHalo(int rank, MPI_Comm fieldComm, Halo *halo) {
+    // Collective over the match communicator, every process learns which process hosts
+    // each subfield
+    int tile = DO_NOT_EXIST;
+    halo->neighbours = 0;
+    if (isField(rank)) {
+        int dims[2] = {getSubfieldRows(), getSubfieldColumns()};
+        int periods[2] = {FALSE, FALSE};
+        int coords[2];
+        int cartRank;
+        MPI_Cart_create(fieldComm, 2, dims, periods, TRUE, &halo->cart);
+        MPI_Comm_rank(halo->cart, &cartRank);
+        MPI_Cart_coords(halo->cart, cartRank, 2, coords);
+        tile = coords[1] + coords[0] * dims[1];
+
+        // Cartesian shifts only give the four edge neighbours, a kick or a run can cross a
+        // corner as well, so the neighbourhood is the full Moore block as a distributed graph
+        int dr, dc;
+        for (dr = -1; dr <= 1; dr++) {
+            for (dc = -1; dc <= 1; dc++) {
+                int neighbour[2] = {coords[0] + dr, coords[1] + dc};
+                if ((dr == 0 && dc == 0) || neighbour[0] < 0 || neighbour[0] >= dims[0] ||
+                    neighbour[1] < 0 || neighbour[1] >= dims[1]) {
+                    continue;
+                }
+                MPI_Cart_rank(halo->cart, neighbour, &halo->neighbourRanks[halo->neighbours]);
+                halo->neighbourTiles[halo->neighbours] = neighbour[1] + neighbour[0] * dims[1];
+                halo->neighbours++;
+            }
+        }
+        // Open MPI defines MPI_UNWEIGHTED as a sentinel pointer, which GCC takes for an
+        // empty weight array and warns about reading from
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wstringop-overread"
+        MPI_Dist_graph_create_adjacent(halo->cart, halo->neighbours, halo->neighbourRanks, MPI_UNWEIGHTED,
+            halo->neighbours, halo->neighbourRanks, MPI_UNWEIGHTED, MPI_INFO_NULL, FALSE, &halo->neighbourhood);
+#pragma GCC diagnostic pop
+
+        int n;
+        for (n = 0; n < halo->neighbours; n++) {
+            halo->sendDisplacements[n] = n * layout.players * HALO_RECORD_INTS;
+            halo->receiveDisplacements[n] = n * layout.players * HALO_RECORD_INTS;
+        }
+        halo->sendBuffer = allocOrAbort(HALO_NEIGHBOURS * layout.players * HALO_RECORD_INTS * sizeof(int));
+        halo->receiveBuffer = allocOrAbort(HALO_NEIGHBOURS * layout.players * HALO_RECORD_INTS * sizeof(int));
+        halo->records = allocOrAbort(layout.players * sizeof(Player));
+        halo->recordRequests = allocOrAbort(layout.players * sizeof(MPI_Request));
+    }
+    halo->tile = tile;
+
+    int *tiles = allocOrAbort(layout.procs * sizeof(int));
+    int r;
+    halo->tileRanks = allocOrAbort(layout.fields * sizeof(int));
+    MPI_Allgather(&tile, 1, MPI_INT, tiles, 1, MPI_INT, tournament.comm);
+    for (r = 0; r < layout.procs; r++) {
+        if (tiles[r] != DO_NOT_EXIST) {
+            halo->tileRanks[tiles[r]] = r;
+        }
+    }
+    free(tiles);
+}
+
+void freeHalo(int rank, Halo *halo) {
+    if (isField(rank)) {
+        MPI_Comm_free(&halo->neighbourhood);
+        MPI_Comm_free(&halo->cart);
+        free(halo->sendBuffer);
+        free(halo->receiveBuffer);
+        free(halo->records);
+        free(halo->recordRequests);
+    }
+    free(halo->tileRanks);
+}
+
+void exchangeNeighbours(Halo *halo) {
+    // Counts go first so every neighbour only receives what is meant for it
+    MPI_Neighbor_alltoall(halo->sendCounts, 1, MPI_INT, halo->receiveCounts, 1, MPI_INT, halo->neighbourhood);
+    MPI_Neighbor_alltoallv(halo->sendBuffer, halo->sendCounts, halo->sendDisplacements, MPI_INT,
+        halo->receiveBuffer, halo->receiveCounts, halo->receiveDisplacements, MPI_INT, halo->neighbourhood);
+}
+
+void startPlayerRecords(Halo *halo, Hosted *hosted, int *startTiles, MPI_Request *requests) {
+    // A player only reports to the subfield it stood in when the round started. The sends
+    // do not block, a hybrid process receives the records for its own subfield next
+    int i;
+    if (wire.compact) {
+        packHostedPlayers(hosted);
+    }
+    for (i = 0; i < hosted->count; i++) {
+        int index = hosted->firstPlayer + i;
+        if (wire.compact) {
+            MPI_Isend(&wire.hostedWords[i], 1, MPI_UINT64_T, halo->tileRanks[startTiles[i]],
+                TAG_PLAYER_RECORD + index, tournament.comm, &requests[i]);
+        } else {
+            MPI_Isend(&hosted->players[i], 1, playerType, halo->tileRanks[startTiles[i]], TAG_PLAYER_RECORD + index,
+                tournament.comm, &requests[i]);
+        }
+    }
+}
+
+void receivePlayerRecords(Halo *halo, Field *field) {
+    // The field expects a record from exactly the players it owns
+    int count = 0;
+    int p;
+    for (p = 0; p < layout.players; p++) {
+        if (playerIsInField(field, p) && wire.compact) {
+            MPI_Irecv(&wire.words[p], 1, MPI_UINT64_T, getPlayerRank(p), TAG_PLAYER_RECORD + p, tournament.comm,
+                &halo->recordRequests[count++]);
+        } else if (playerIsInField(field, p)) {
+            MPI_Irecv(&halo->records[p], 1, playerType, getPlayerRank(p), TAG_PLAYER_RECORD + p, tournament.comm,
+                &halo->recordRequests[count++]);
+        }
+    }
+    MPI_Waitall(count, halo->recordRequests, MPI_STATUSES_IGNORE);
+
+    for (p = 0; p < layout.players; p++) {
+        if (playerIsInField(field, p) && wire.compact) {
+            unpackPlayer(p, wire.words[p], &field->players[p]);
+        } else if (playerIsInField(field, p)) {
+            field->players[p] = halo->records[p];
+        }
+    }
+}
+
+void migratePlayers(Halo *halo, Field *field) {
+    // Players that moved into a neighbouring subfield are handed over to it, so afterwards
+    // every field owns the players standing in it
+    int n, p, i;
+    for (n = 0; n < halo->neighbours; n++) {
+        halo->sendCounts[n] = 0;
+    }
+    for (p = 0; p < layout.players; p++) {
+        Player *player = &field->players[p];
+        if (!playerIsInField(field, p)) {
+            continue;
+        }
+        int tile = getFieldRankFromCoords(player->currX, player->currY);
+        if (tile != halo->tile) {
+            n = getNeighbourIndex(halo, tile);
+            int *record = &halo->sendBuffer[halo->sendDisplacements[n] + halo->sendCounts[n]];
+            record[0] = p;
+            memcpy(&record[1], player, sizeof(Player));
+            halo->sendCounts[n] += HALO_RECORD_INTS;
+            player->currX = DO_NOT_EXIST;
+            player->currY = DO_NOT_EXIST;
+        }
+    }
+    exchangeNeighbours(halo);
+
+    for (n = 0; n < halo->neighbours; n++) {
+        for (i = 0; i < halo->receiveCounts[n]; i += HALO_RECORD_INTS) {
+            int *record = &halo->receiveBuffer[halo->receiveDisplacements[n] + i];
+            memcpy(&field->players[record[0]], &record[1], sizeof(Player));
+        }
+    }
+}
+
+void exchangeKickPositions(Halo *halo, Field *field, Ball *ball, PassIndex *passIndex) {
+    // Only the subfield holding the ball can see a kick, it gets the position of every
+    // player within kick range of it from its neighbours. Everyone else is out of range
+    int ballTile = getFieldRankFromCoords(ball->x, ball->y);
+    int target = getNeighbourIndex(halo, ballTile);
+    int n, p, i;
+    for (n = 0; n < halo->neighbours; n++) {
+        halo->sendCounts[n] = 0;
+    }
+    clearPassIndex(passIndex);
+    for (p = 0; p < layout.players; p++) {
+        if (!playerIsInField(field, p)) {
+            continue;
+        }
+
+        Player *player = &field->players[p];
+        placeInPassIndex(passIndex, p, player->currX, player->currY);
+        if (target != DO_NOT_EXIST &&
+            getDistanceToSubfield(ballTile, player->currX, player->currY) <= HALO_KICK_RANGE) {
+            int *ghost = &halo->sendBuffer[halo->sendDisplacements[target] + halo->sendCounts[target]];
+            ghost[0] = p;
+            ghost[1] = player->currX;
+            ghost[2] = player->currY;
+            halo->sendCounts[target] += HALO_GHOST_INTS;
+        }
+    }
+    exchangeNeighbours(halo);
+
+    for (n = 0; n < halo->neighbours; n++) {
+        for (i = 0; i < halo->receiveCounts[n]; i += HALO_GHOST_INTS) {
+            int *ghost = &halo->receiveBuffer[halo->receiveDisplacements[n] + i];
+            placeInPassIndex(passIndex, ghost[0], ghost[1], ghost[2]);
+        }
+    }
+}
+
+void resolveKick(Halo *halo, Field *field, Ball *ball, PassIndex *passIndex, int round, uint64_t seed,
+    int newPosition[2], Result *result) {
+    // Every player that reached the ball stands on it, so the subfield holding the ball
+    // owns all claims and decides the kick on its own
+    newPosition[0] = ball->x;
+    newPosition[1] = ball->y;
+    if (halo->tile != getFieldRankFromCoords(ball->x, ball->y)) {
+        return;
+    }
+
+    KickClaim winner = {PLAYER_NO_CHALLENGE, 0, DO_NOT_EXIST, DO_NOT_EXIST, DO_NOT_EXIST};
+    int p;
+    for (p = 0; p < layout.players; p++) {
+        if (playerIsInField(field, p)) {
+            KickClaim claim;
+            makeKickClaim(p, &field->players[p], round, seed, &claim);
+            if (kickClaimBeats(&claim, &winner)) {
+                winner = claim;
+            }
+        }
+    }
+    if (winner.challenge == PLAYER_NO_CHALLENGE) {
+        return;
+    }
+
+    Ball kicked = *ball;
+    Player *kicker = &field->players[winner.player];
+    kicker->kicked = PLAYER_KICKED_BALL;
+    tallyKick(result, kicker->team, playerKickBallIndexed(winner.player, kicker, &kicked, passIndex, round, seed));
+    newPosition[0] = kicked.x;
+    newPosition[1] = kicked.y;
+}
+
+void shareKickedBall(Halo *halo, Hosted *hosted, Ball *ball, int newPosition[2]) {
+    // Every process knows where the ball was, so it knows which field sends the new position
+    int root = halo->tileRanks[getFieldRankFromCoords(ball->x, ball->y)];
+    MPI_Bcast(newPosition, 2, MPI_INT, root, tournament.comm);
+    ball->x = newPosition[0];
+    ball->y = newPosition[1];
+    placeHostedBall(hosted, newPosition);
+}
+
+/* ================ ONE-SIDED RECORDS ================*/
+void initRma(Hosted *hosted, Rma *rma) {
+    // Collective over the match communicator, slot p of hosted subfield t is record t * players + p
+    int slots = hosted->tiles * layout.players;
+    int i, m;
+
+    // Open MPI names the shared memory behind a window after the communicator context id,
+    // which the disjoint communicators of a tournament may share, so matches allocate
+    // their windows one after the other
+    for (m = 0; m < tournament.matches; m++) {
+        if (m == tournament.match) {
+            MPI_Win_allocate((MPI_Aint) slots * sizeof(Player), sizeof(Player), MPI_INFO_NULL, tournament.comm,
+                &rma->inbox, &rma->win);
+        }
+        if (tournament.active) {
+            MPI_Barrier(MPI_COMM_WORLD);
+        }
+    }
+    for (i = 0; i < slots; i++) {
+        rma->inbox[i] = hosted->fields[i / layout.players].players[i % layout.players];
+    }
+
+    rma->ownerTiles = allocOrAbort((hosted->count > 0 ? hosted->count : 1) * sizeof(int));
+    rma->leaving = allocOrAbort((hosted->count > 0 ? hosted->count : 1) * sizeof(Player));
+    rma->fetched = allocOrAbort(layout.fields * layout.players * sizeof(Player));
+    for (i = 0; i < hosted->count; i++) {
+        rma->ownerTiles[i] = DO_NOT_EXIST;
+    }
+    MPI_Win_fence(MPI_MODE_NOPRECEDE, rma->win);
+}
+
+void freeRma(Rma *rma) {
+    MPI_Win_fence(MPI_MODE_NOSUCCEED, rma->win);
+    MPI_Win_free(&rma->win);
+    free(rma->ownerTiles);
+    free(rma->leaving);
+    free(rma->fetched);
+}
+
+void putRecord(Rma *rma, Player *record, int tile, int index) {
+    int rank = getTileRank(tile);
+    MPI_Aint slot = (MPI_Aint) (tile - getFirstTile(rank)) * layout.players + index;
+    MPI_Put(record, 1, playerType, rank, slot, 1, playerType, rma->win);
+}
+
+void putPlayerRecords(Rma *rma, Hosted *hosted) {
+    // A player belongs to the subfield holding its previous position. When that changes,
+    // the slot it leaves is cleared in the same epoch, the two slots never overlap
+    int i;
+    for (i = 0; i < hosted->count; i++) {
+        Player *player = &hosted->players[i];
+        int index = hosted->firstPlayer + i;
+        int tile = getFieldRankFromCoords(player->prevX, player->prevY);
+        if (rma->ownerTiles[i] != DO_NOT_EXIST && rma->ownerTiles[i] != tile) {
+            rma->leaving[i] = *player;
+            rma->leaving[i].currX = DO_NOT_EXIST;
+            rma->leaving[i].currY = DO_NOT_EXIST;
+            putRecord(rma, &rma->leaving[i], rma->ownerTiles[i], index);
+        }
+        putRecord(rma, player, tile, index);
+        rma->ownerTiles[i] = tile;
+    }
+}
+
+void syncPlayerRecords(Rma *rma, Hosted *hosted) {
+    // Fields never store to the window and the next epoch only reads it, so every field
+    // can copy its slots out while the kicker fetches
+    MPI_Win_fence(MPI_MODE_NOSTORE | MPI_MODE_NOPUT, rma->win);
+    int t;
+    for (t = 0; t < hosted->tiles; t++) {
+        memcpy(hosted->fields[t].players, &rma->inbox[t * layout.players], layout.players * sizeof(Player));
+    }
+}
+
+int tileNearKick(int tile, KickClaim *winner) {
+    return getDistanceToSubfield(tile, winner->x, winner->y) <= KICK_RANGE_MAX ? TRUE : FALSE;
+}
+
+void fetchKickPositions(int rank, Rma *rma, KickClaim *winner, PassIndex *passIndex) {
+    // Only the process hosting the kicker needs its teammates, it reads the slots of the
+    // subfields within the longest kick of the ball
+    int kicker = winner->challenge != PLAYER_NO_CHALLENGE && rank == getPlayerRank(winner->player);
+    int p, t;
+    if (kicker) {
+        for (t = 0; t < layout.fields; t++) {
+            if (tileNearKick(t, winner)) {
+                int f = getTileRank(t);
+                MPI_Get(&rma->fetched[t * layout.players], layout.players, playerType, f,
+                    (MPI_Aint) (t - getFirstTile(f)) * layout.players, layout.players, playerType, rma->win);
+            }
+        }
+    }
+    MPI_Win_fence(MPI_MODE_NOSTORE, rma->win);
+    if (!kicker) {
+        return;
+    }
+
+    clearPassIndex(passIndex);
+    for (t = 0; t < layout.fields; t++) {
+        if (!tileNearKick(t, winner)) {
+            continue;
+        }
+        for (p = 0; p < layout.players; p++) {
+            Player *record = &rma->fetched[t * layout.players + p];
+            if (record->currX != DO_NOT_EXIST && record->currY != DO_NOT_EXIST && isTeammate(winner->player, p)) {
+                placeInPassIndex(passIndex, p, record->currX, record->currY);
+            }
+        }
+    }
+}
+
+void exchangeInitialRecords(Rma *rma, Hosted *hosted) {
+    // Same epochs as a round without a kick
+    putPlayerRecords(rma, hosted);
+    syncPlayerRecords(rma, hosted);
+    MPI_Win_fence(MPI_MODE_NOSTORE, rma->win);
+}
+
+void markFieldKicker(Hosted *hosted, KickClaim *winner) {
+    // The kicked flag is the only change to the records after they were put, every field
+    // learns the winner from the reduction and applies it to its own copy
+    int t;
+    if (winner->challenge == PLAYER_NO_CHALLENGE) {
+        return;
+    }
+    for (t = 0; t < hosted->tiles; t++) {
+        if (playerIsInField(&hosted->fields[t], winner->player)) {
+            hosted->fields[t].players[winner->player].kicked = PLAYER_KICKED_BALL;
+        }
+    }
+}
+
+/* ================ NODE SHARED FIELDS ================*/
+void initSharedFields(int rank, MPI_Comm fieldComm, SharedFields *shared) {
+    // Collective over the match communicator. A field process outside the gather reads the
+    // records of its leader, one that hosts players as well keeps its own copy
+    shared->node = MPI_COMM_NULL;
+    shared->leaders = MPI_COMM_NULL;
+    shared->leader = FALSE;
+    shared->nodeSize = 0;
+    shared->worldRanks = NULL;
+    shared->storage = NULL;
+    shared->records = NULL;
+    shared->view.tiles = 0;
+    shared->view.fields = NULL;
+
+    int excluded = FALSE;
+    if (isField(rank)) {
+        int nodeRank, unit;
+        MPI_Aint size;
+        char *leaderBase;
+        MPI_Comm_split_type(fieldComm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &shared->node);
+        MPI_Comm_rank(shared->node, &nodeRank);
+        MPI_Comm_size(shared->node, &shared->nodeSize);
+        shared->leader = nodeRank == 0 ? TRUE : FALSE;
+        shared->worldRanks = allocOrAbort(shared->nodeSize * sizeof(int));
+        MPI_Allgather(&rank, 1, MPI_INT, shared->worldRanks, 1, MPI_INT, shared->node);
+        MPI_Comm_split(fieldComm, shared->leader ? 0 : MPI_UNDEFINED, rank, &shared->leaders);
+
+        size = getTileCount(rank) * getTileBytes() + (shared->leader ? layout.players * sizeof(Player) : 0);
+        MPI_Win_allocate_shared(size, 1, MPI_INFO_NULL, shared->node, &shared->storage, &shared->win);
+        MPI_Win_lock_all(MPI_MODE_NOCHECK, shared->win);
+
+        excluded = !shared->leader && !hostsPlayers(rank);
+        if (shared->leader || excluded) {
+            MPI_Win_shared_query(shared->win, 0, &size, &unit, &leaderBase);
+            shared->records = (Player *) (leaderBase + getTileCount(shared->worldRanks[0]) * getTileBytes());
+        }
+    }
+    MPI_Comm_split(tournament.comm, excluded ? MPI_UNDEFINED : 0, rank, &shared->gather);
+}
+
+void buildNodeView(SharedFields *shared) {
+    // The leader sees every subfield on the node through the segment
+    int k, t, tiles = 0;
+    if (!shared->leader) {
+        return;
+    }
+    for (k = 0; k < shared->nodeSize; k++) {
+        tiles += getTileCount(shared->worldRanks[k]);
+    }
+    shared->view.tiles = tiles;
+    shared->view.fields = allocOrAbort(tiles * sizeof(Field));
+
+    tiles = 0;
+    for (k = 0; k < shared->nodeSize; k++) {
+        int unit;
+        MPI_Aint size;
+        char *base;
+        MPI_Win_shared_query(shared->win, k, &size, &unit, &base);
+        for (t = 0; t < getTileCount(shared->worldRanks[k]); t++) {
+            attachField(&shared->view.fields[tiles++], base + t * getTileBytes());
+        }
+    }
+}
+
+void routeOutputThroughLeaders(SharedFields *shared, MPI_Comm fieldComm, OutputGather *output) {
+    // Collective over the field processes, each one sends its output through its leader
+    int source = 0;
+    if (shared->leader) {
+        MPI_Comm_rank(shared->leaders, &source);
+        MPI_Comm_size(shared->leaders, &output->sources);
+    }
+    MPI_Bcast(&source, 1, MPI_INT, 0, shared->node);
+    MPI_Bcast(&output->sources, 1, MPI_INT, 0, fieldComm);
+    MPI_Allgather(&source, 1, MPI_INT, output->sourceOf, 1, MPI_INT, fieldComm);
+}
+
+void syncNodeFields(int rank, SharedFields *shared) {
+    // Stores to the segment before this point are visible to the whole node after it
+    if (!isField(rank)) {
+        return;
+    }
+    MPI_Win_sync(shared->win);
+    MPI_Barrier(shared->node);
+    MPI_Win_sync(shared->win);
+}
+
+void freeSharedFields(SharedFields *shared) {
+    if (shared->node != MPI_COMM_NULL) {
+        MPI_Win_unlock_all(shared->win);
+        MPI_Win_free(&shared->win);
+        MPI_Comm_free(&shared->node);
+    }
+    if (shared->leaders != MPI_COMM_NULL) {
+        MPI_Comm_free(&shared->leaders);
+    }
+    if (shared->gather != MPI_COMM_NULL) {
+        MPI_Comm_free(&shared->gather);
+    }
+    free(shared->worldRanks);
+    free(shared->view.fields);
+}
+
+/* ================= DELTA SCHEDULE =================*/
+void initDelta(int rank, MPI_Comm fieldComm, Hosted *hosted, Delta *delta) {
+    // Collective over the match communicator, after the initial records reached the fields
+    int slot = (layout.players + 1) * DELTA_NOTICE_INTS;
+    int p, t;
+    delta->fieldComm = fieldComm;
+    delta->fieldRank = rank;
+    MPI_Comm_split(tournament.comm, hostsPlayers(rank) ? 0 : MPI_UNDEFINED, rank, &delta->playerComm);
+
+    delta->owned = allocOrAbort(layout.players);
+    delta->records = allocOrAbort(layout.players * sizeof(Player));
+    delta->requests = allocOrAbort((layout.players + layout.fieldRanks + 1) * sizeof(MPI_Request));
+    delta->statuses = allocOrAbort((layout.players + layout.fieldRanks + 1) * sizeof(MPI_Status));
+    delta->sendCounts = allocOrAbort(layout.fieldRanks * sizeof(int));
+    delta->messages = allocOrAbort(layout.fieldRanks * sizeof(int));
+    delta->sendBuffer = allocOrAbort(layout.fieldRanks * slot * sizeof(int));
+    delta->receiveBuffer = allocOrAbort(slot * sizeof(int));
+    delta->positionBuffer = allocOrAbort(slot * sizeof(int));
+    delta->kickBuffer = allocOrAbort(layout.fieldRanks * slot * sizeof(int));
+    delta->ballLeaving = FALSE;
+
+    for (p = 0; p < layout.players; p++) {
+        delta->owned[p] = FALSE;
+        for (t = 0; t < hosted->tiles; t++) {
+            if (playerIsInField(&hosted->fields[t], p)) {
+                delta->owned[p] = TRUE;
+            }
+        }
+    }
+}
+
+void freeDelta(Delta *delta) {
+    if (delta->playerComm != MPI_COMM_NULL) {
+        MPI_Comm_free(&delta->playerComm);
+    }
+    free(delta->owned);
+    free(delta->records);
+    free(delta->requests);
+    free(delta->statuses);
+    free(delta->sendCounts);
+    free(delta->messages);
+    free(delta->sendBuffer);
+    free(delta->receiveBuffer);
+    free(delta->positionBuffer);
+    free(delta->kickBuffer);
+}
+
+void startOwnerRecords(Hosted *hosted, MPI_Request *requests) {
+    // A player only reports to the process hosting the subfield of its previous position
+    int i;
+    if (wire.compact) {
+        packHostedPlayers(hosted);
+    }
+    for (i = 0; i < hosted->count; i++) {
+        Player *player = &hosted->players[i];
+        if (wire.compact) {
+            MPI_Isend(&wire.hostedWords[i], 1, MPI_UINT64_T, getOwnerRank(player->prevX, player->prevY),
+                TAG_PLAYER_RECORD + hosted->firstPlayer + i, tournament.comm, &requests[i]);
+        } else {
+            MPI_Isend(player, 1, playerType, getOwnerRank(player->prevX, player->prevY), TAG_PLAYER_RECORD + hosted->firstPlayer + i,
+                tournament.comm, &requests[i]);
+        }
+    }
+}
+
+void receiveOwnedRecords(Delta *delta, Hosted *hosted) {
+    // The process expects a record from exactly the players it owns, players that left
+    // simply stop reporting
+    int count = 0;
+    int p, t;
+    for (p = 0; p < layout.players; p++) {
+        if (delta->owned[p] && wire.compact) {
+            MPI_Irecv(&wire.words[p], 1, MPI_UINT64_T, getPlayerRank(p), TAG_PLAYER_RECORD + p, tournament.comm,
+                &delta->requests[count++]);
+        } else if (delta->owned[p]) {
+            MPI_Irecv(&delta->records[p], 1, playerType, getPlayerRank(p), TAG_PLAYER_RECORD + p, tournament.comm,
+                &delta->requests[count++]);
+        }
+    }
+    MPI_Waitall(count, delta->requests, MPI_STATUSES_IGNORE);
+    for (p = 0; p < layout.players; p++) {
+        if (delta->owned[p] && wire.compact) {
+            unpackPlayer(p, wire.words[p], &delta->records[p]);
+        }
+    }
+
+    for (t = 0; t < hosted->tiles; t++) {
+        Field *field = &hosted->fields[t];
+        for (p = 0; p < layout.players; p++) {
+            if (playerIsInField(field, p)) {
+                field->players[p].currX = DO_NOT_EXIST;
+                field->players[p].currY = DO_NOT_EXIST;
+            }
+        }
+    }
+    for (p = 0; p < layout.players; p++) {
+        if (delta->owned[p]) {
+            Player *record = &delta->records[p];
+            t = getFieldRankFromCoords(record->prevX, record->prevY) - hosted->firstTile;
+            hosted->fields[t].players[p] = *record;
+        }
+    }
+}
+
+int fieldNearKick(int rank, KickClaim *winner) {
+    int t;
+    for (t = getFirstTile(rank); t < getFirstTile(rank + 1); t++) {
+        if (tileNearKick(t, winner)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+void collectKickPositions(int rank, Delta *delta, Hosted *hosted, KickClaim *winner, PassIndex *passIndex) {
+    // Only the process hosting the kicker needs its teammates. Every field within the
+    // longest kick of the ball sends it the teammates it owns there, the others stay out
+    if (winner->challenge == PLAYER_NO_CHALLENGE) {
+        return;
+    }
+    int kickerRank = getPlayerRank(winner->player);
+    int slot = (layout.players + 1) * DELTA_NOTICE_INTS;
+    int count = 0;
+    int f, i, p, t;
+    if (isField(rank) && fieldNearKick(rank, winner)) {
+        int sendCount = 0;
+        for (t = 0; t < hosted->tiles; t++) {
+            for (p = 0; p < layout.players; p++) {
+                Player *record = &hosted->fields[t].players[p];
+                if (playerIsInField(&hosted->fields[t], p) && isTeammate(winner->player, p) &&
+                    bothPointsInRange(winner->x, winner->y, record->currX, record->currY, KICK_RANGE_MAX)) {
+                    delta->positionBuffer[sendCount++] = p;
+                    delta->positionBuffer[sendCount++] = record->currX;
+                    delta->positionBuffer[sendCount++] = record->currY;
+                }
+            }
+        }
+        MPI_Isend(delta->positionBuffer, sendCount, MPI_INT, kickerRank, TAG_KICK_POSITIONS, tournament.comm,
+            &delta->requests[count++]);
+    }
+    int firstReceive = count;
+    if (rank == kickerRank) {
+        for (f = 0; f < layout.fieldRanks; f++) {
+            if (fieldNearKick(f, winner)) {
+                MPI_Irecv(&delta->kickBuffer[f * slot], slot, MPI_INT, f, TAG_KICK_POSITIONS, tournament.comm,
+                    &delta->requests[count++]);
+            }
+        }
+    }
+    MPI_Waitall(count, delta->requests, delta->statuses);
+    if (rank != kickerRank) {
+        return;
+    }
+
+    clearPassIndex(passIndex);
+    for (f = firstReceive; f < count; f++) {
+        int received;
+        int *notices = &delta->kickBuffer[delta->statuses[f].MPI_SOURCE * slot];
+        MPI_Get_count(&delta->statuses[f], MPI_INT, &received);
+        for (i = 0; i < received; i += DELTA_NOTICE_INTS) {
+            placeInPassIndex(passIndex, notices[i], notices[i + 1], notices[i + 2]);
+        }
+    }
+}
+
+void handOverKickedBall(int rank, Delta *delta, Hosted *hosted, KickClaim *winner, Ball *ball, int ballRank) {
+    // The kicker tells the process that held the ball where it went and every process
+    // hosting players, which all run towards it. The other fields do not hear about it.
+    // Only players track the ball, so ballRank is only known to the kicker, the field
+    // holding the ball finds it in its own subfields
+    if (winner->challenge == PLAYER_NO_CHALLENGE) {
+        return;
+    }
+    int kickerRank = getPlayerRank(winner->player);
+    int holdsBall = isField(rank) && getHostedBall(hosted) != NULL;
+    int newPosition[2];
+    MPI_Request request;
+    if (rank == kickerRank) {
+        newPosition[0] = ball->x;
+        newPosition[1] = ball->y;
+        MPI_Isend(newPosition, 2, MPI_INT, ballRank, TAG_BALL_HANDOVER, tournament.comm, &request);
+    }
+    if (hostsPlayers(rank)) {
+        MPI_Bcast(newPosition, 2, MPI_INT, kickerRank - layout.firstPlayerRank, delta->playerComm);
+        ball->x = newPosition[0];
+        ball->y = newPosition[1];
+    }
+    if (holdsBall) {
+        MPI_Recv(delta->leavingBall, 2, MPI_INT, kickerRank, TAG_BALL_HANDOVER, tournament.comm, MPI_STATUS_IGNORE);
+        placeHostedBall(hosted, delta->leavingBall);
+        delta->ballLeaving = getHostedBall(hosted) == NULL;
+    }
+    if (rank == kickerRank) {
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+    }
+}
+
+void addNotice(Delta *delta, int fieldRank, int index, int x, int y) {
+    int *notice = &delta->sendBuffer[fieldRank * (layout.players + 1) * DELTA_NOTICE_INTS +
+        delta->sendCounts[fieldRank]];
+    notice[0] = index;
+    notice[1] = x;
+    notice[2] = y;
+    delta->sendCounts[fieldRank] += DELTA_NOTICE_INTS;
+}
+
+void exchangeDeltas(Delta *delta, Hosted *hosted) {
+    // A player whose position is now in a subfield of another process belongs there next
+    // round, as does a ball kicked out. Fields learn how many processes write to them from
+    // one reduction, the notices themselves only travel between the two processes involved
+    int slot = (layout.players + 1) * DELTA_NOTICE_INTS;
+    int incoming, sent = 0;
+    int f, i, p, t;
+    for (f = 0; f < layout.fieldRanks; f++) {
+        delta->sendCounts[f] = 0;
+    }
+    for (t = 0; t < hosted->tiles; t++) {
+        Field *field = &hosted->fields[t];
+        for (p = 0; p < layout.players; p++) {
+            if (playerIsInField(field, p)) {
+                int owner = getOwnerRank(field->players[p].currX, field->players[p].currY);
+                if (owner != delta->fieldRank) {
+                    delta->owned[p] = FALSE;
+                    addNotice(delta, owner, p, DO_NOT_EXIST, DO_NOT_EXIST);
+                }
+            }
+        }
+    }
+    if (delta->ballLeaving) {
+        int owner = getOwnerRank(delta->leavingBall[0], delta->leavingBall[1]);
+        addNotice(delta, owner, DELTA_BALL, delta->leavingBall[0], delta->leavingBall[1]);
+        delta->ballLeaving = FALSE;
+    }
+
+    for (f = 0; f < layout.fieldRanks; f++) {
+        delta->messages[f] = delta->sendCounts[f] > 0 ? 1 : 0;
+    }
+    MPI_Reduce_scatter_block(delta->messages, &incoming, 1, MPI_INT, MPI_SUM, delta->fieldComm);
+    for (f = 0; f < layout.fieldRanks; f++) {
+        if (delta->sendCounts[f] > 0) {
+            MPI_Isend(&delta->sendBuffer[f * slot], delta->sendCounts[f], MPI_INT, f, TAG_DELTA_NOTICE,
+                delta->fieldComm, &delta->requests[sent++]);
+        }
+    }
+
+    while (incoming-- > 0) {
+        MPI_Status status;
+        int received;
+        MPI_Recv(delta->receiveBuffer, slot, MPI_INT, MPI_ANY_SOURCE, TAG_DELTA_NOTICE, delta->fieldComm, &status);
+        MPI_Get_count(&status, MPI_INT, &received);
+        for (i = 0; i < received; i += DELTA_NOTICE_INTS) {
+            int *notice = &delta->receiveBuffer[i];
+            if (notice[0] == DELTA_BALL) {
+                placeHostedBall(hosted, &notice[1]);
+            } else {
+                delta->owned[notice[0]] = TRUE;
+            }
+        }
+    }
+    MPI_Waitall(sent, delta->requests, MPI_STATUSES_IGNORE);
+}
+
+/* ================ SUBFIELD BALANCE ================*/
+void initBalance(int every, Balance *balance) {
+    balance->every = every;
+    balance->weights = allocOrAbort(layout.fields * sizeof(int));
+    balance->totals = allocOrAbort(layout.fields * sizeof(int));
+    balance->starts = allocOrAbort((layout.fieldRanks + 1) * sizeof(int));
+    balance->sendCounts = allocOrAbort(layout.fieldRanks * sizeof(int));
+    balance->sendDisplacements = allocOrAbort(layout.fieldRanks * sizeof(int));
+    balance->receiveCounts = allocOrAbort(layout.fieldRanks * sizeof(int));
+    balance->receiveDisplacements = allocOrAbort(layout.fieldRanks * sizeof(int));
+}
+
+void freeBalance(Balance *balance) {
+    free(balance->weights);
+    free(balance->totals);
+    free(balance->starts);
+    free(balance->sendCounts);
+    free(balance->sendDisplacements);
+    free(balance->receiveCounts);
+    free(balance->receiveDisplacements);
+}
+
+void recordOccupancy(Balance *balance, Hosted *hosted) {
+    int t, p;
+    for (t = 0; t < hosted->tiles; t++) {
+        int *weight = &balance->weights[hosted->firstTile + t];
+        *weight += 1;
+        for (p = 0; p < layout.players; p++) {
+            if (playerIsInField(&hosted->fields[t], p)) {
+                *weight += 1;
+            }
+        }
+    }
+}
+
+void bisectTiles(int *weights, int first, int last, int firstRank, int ranks, int *starts) {
+    // Splits subfields first up to last between the ranks so both halves carry a share of
+    // the weight in proportion to their number of processes, every process keeps at least
+    // one subfield
+    if (ranks == 1) {
+        starts[firstRank] = first;
+        return;
+    }
+    int leftRanks = ranks / 2;
+    long total = 0, prefix = 0;
+    int t, split;
+    for (t = first; t < last; t++) {
+        total += weights[t];
+    }
+    long target = total * leftRanks / ranks;
+    for (t = first; t < first + leftRanks; t++) {
+        prefix += weights[t];
+    }
+    split = first + leftRanks;
+    while (split < last - (ranks - leftRanks) && labs(prefix + weights[split] - target) < labs(prefix - target)) {
+        prefix += weights[split++];
+    }
+    bisectTiles(weights, first, split, firstRank, leftRanks, starts);
+    bisectTiles(weights, split, last, firstRank + leftRanks, ranks - leftRanks, starts);
+}
+
+int getOverlap(int first1, int last1, int first2, int last2) {
+    int first = first1 > first2 ? first1 : first2;
+    int last = last1 < last2 ? last1 : last2;
+    return last > first ? last - first : 0;
+}
+
+void balanceSubfields(int rank, Balance *balance, Hosted *hosted, MPI_Comm fieldComm) {
+    // Collective over the match communicator. Every process derives the same ownership map
+    // from the summed weights, then field processes hand the blocks of the subfields
+    // changing hands straight to their new hosts, ball and records included
+    int f;
+    MPI_Allreduce(balance->weights, balance->totals, layout.fields, MPI_INT, MPI_SUM, tournament.comm);
+    memset(balance->weights, 0, layout.fields * sizeof(int));
+    bisectTiles(balance->totals, 0, layout.fields, 0, layout.fieldRanks, balance->starts);
+    balance->starts[layout.fieldRanks] = layout.fields;
+    if (memcmp(balance->starts, layout.tileStarts, (layout.fieldRanks + 1) * sizeof(int)) == 0) {
+        return;
+    }
+
+    if (isField(rank)) {
+        int first = balance->starts[rank], last = balance->starts[rank + 1];
+        int tileBytes = (int) getTileBytes();
+        for (f = 0; f < layout.fieldRanks; f++) {
+            int sendFirst = getFirstTile(rank) > balance->starts[f] ? getFirstTile(rank) : balance->starts[f];
+            int receiveFirst = getFirstTile(f) > first ? getFirstTile(f) : first;
+            balance->sendCounts[f] = getOverlap(getFirstTile(rank), getFirstTile(rank + 1), balance->starts[f],
+                balance->starts[f + 1]) * tileBytes;
+            balance->sendDisplacements[f] = (sendFirst - getFirstTile(rank)) * tileBytes;
+            balance->receiveCounts[f] = getOverlap(getFirstTile(f), getFirstTile(f + 1), first, last) * tileBytes;
+            balance->receiveDisplacements[f] = (receiveFirst - first) * tileBytes;
+        }
+        char *storage = allocOrAbort((last - first) * tileBytes);
+        MPI_Alltoallv(hosted->storage, balance->sendCounts, balance->sendDisplacements, MPI_BYTE, storage,
+            balance->receiveCounts, balance->receiveDisplacements, MPI_BYTE, fieldComm);
+        rehostTiles(hosted, first, last - first, storage);
+    }
+    setTileStarts(balance->starts);
+}
+
+/* ================== CHECKPOINTS ==================*/
+MPI_Offset getCheckpointSlotBytes() {
+    return (MPI_Offset) sizeof(CheckpointHeader) + (MPI_Offset) layout.players * sizeof(Player) +
+        (MPI_Offset) layout.fields * getTileBytes();
+}
+
+MPI_Offset getCheckpointPlayerOffset(int slot, int index) {
+    return slot * getCheckpointSlotBytes() + sizeof(CheckpointHeader) + (MPI_Offset) index * sizeof(Player);
+}
+
+MPI_Offset getCheckpointTileOffset(int slot, int tile) {
+    return getCheckpointPlayerOffset(slot, layout.players) + (MPI_Offset) tile * getTileBytes();
+}
+
+uint64_t hashCheckpointPart(uint64_t part, const void *data, size_t size) {
+    // FNV-1a keyed by the part, parts are summed so every process hashes its own
+    const unsigned char *bytes = data;
+    uint64_t hash = 14695981039346656037ULL ^ part;
+    size_t i;
+    for (i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+void fillCheckpointHeader(CheckpointHeader *header, int round, uint64_t seed) {
+    memset(header, 0, sizeof(CheckpointHeader));
+    memcpy(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic));
+    header->round = round;
+    header->fieldLength = matchConfig.fieldLength;
+    header->fieldWidth = matchConfig.fieldWidth;
+    header->subfieldLength = matchConfig.subfieldLength;
+    header->subfieldWidth = matchConfig.subfieldWidth;
+    header->players = layout.players;
+    header->fields = layout.fields;
+    header->seed = seed;
+}
+
+int readCheckpointSlot(Checkpoint *checkpoint, int slot, char *buffer, CheckpointHeader *header) {
+    // Returns TRUE when the slot holds a complete checkpoint of this match
+    CheckpointHeader expected;
+    MPI_Status status;
+    int bytes, p, t;
+    MPI_File_read_at(checkpoint->file, slot * checkpoint->slotBytes, buffer, (int) checkpoint->slotBytes,
+        MPI_BYTE, &status);
+    MPI_Get_count(&status, MPI_BYTE, &bytes);
+    if (bytes != checkpoint->slotBytes) {
+        return FALSE;
+    }
+    memcpy(header, buffer, sizeof(CheckpointHeader));
+    fillCheckpointHeader(&expected, header->round, header->seed);
+    expected.checksum = header->checksum;
+    if (memcmp(header, &expected, sizeof(CheckpointHeader)) != 0) {
+        return FALSE;
+    }
+
+    uint64_t checksum = 0;
+    char *records = buffer + sizeof(CheckpointHeader);
+    for (p = 0; p < layout.players; p++) {
+        checksum += hashCheckpointPart(p, records + p * sizeof(Player), sizeof(Player));
+    }
+    for (t = 0; t < layout.fields; t++) {
+        checksum += hashCheckpointPart(layout.players + t,
+            records + layout.players * sizeof(Player) + t * getTileBytes(), getTileBytes());
+    }
+    return checksum == header->checksum ? TRUE : FALSE;
+}
+
+void openCheckpoint(int rank, Options *options, Checkpoint *checkpoint) {
+    // Collective over the match communicator. On restart field process 0 picks the newest
+    // complete slot, whose seed then replaces the one given
+    int mode = options->restart ? MPI_MODE_RDWR : MPI_MODE_RDWR | MPI_MODE_CREATE;
+    checkpoint->every = options->checkpointEvery;
+    checkpoint->written = 0;
+    checkpoint->slotBytes = getCheckpointSlotBytes();
+    checkpoint->header.round = DO_NOT_EXIST;
+    if (MPI_File_open(tournament.comm, options->checkpointPath, mode, MPI_INFO_NULL, &checkpoint->file) !=
+        MPI_SUCCESS) {
+        abortWithError(rank, "cannot open the checkpoint file");
+    }
+    if (!options->restart) {
+        return;
+    }
+
+    if (rank == 0) {
+        char *buffer = allocOrAbort(checkpoint->slotBytes);
+        CheckpointHeader header;
+        int slot;
+        for (slot = 0; slot < CHECKPOINT_SLOTS; slot++) {
+            if (readCheckpointSlot(checkpoint, slot, buffer, &header) && header.round > checkpoint->header.round) {
+                checkpoint->header = header;
+                checkpoint->written = slot + 1;
+            }
+        }
+        free(buffer);
+    }
+    MPI_Bcast(&checkpoint->header, sizeof(CheckpointHeader), MPI_BYTE, 0, tournament.comm);
+    MPI_Bcast(&checkpoint->written, 1, MPI_INT, 0, tournament.comm);
+    if (checkpoint->header.round == DO_NOT_EXIST) {
+        abortWithError(rank, "the checkpoint file holds no complete checkpoint of this match");
+    }
+    options->hasSeed = TRUE;
+    options->seed = checkpoint->header.seed;
+}
+
+void writeCheckpoint(int rank, Checkpoint *checkpoint, Hosted *hosted, int round, uint64_t seed) {
+    // Collective over the match communicator, after the round. Every process writes its
+    // players and its subfields as two contiguous pieces of the slot, too small to gain
+    // anything from collective buffering. The header only follows once every piece is
+    // written and the checksum over all of them is known, so a slot cut short is never
+    // taken for a complete one
+    int slot = checkpoint->written % CHECKPOINT_SLOTS;
+    uint64_t checksum = 0, total = 0;
+    int i, t;
+    MPI_File_write_at(checkpoint->file, getCheckpointPlayerOffset(slot, hosted->firstPlayer), hosted->players,
+        (int) (hosted->count * sizeof(Player)), MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_write_at(checkpoint->file, getCheckpointTileOffset(slot, hosted->firstTile), hosted->storage,
+        (int) (hosted->tiles * getTileBytes()), MPI_BYTE, MPI_STATUS_IGNORE);
+    for (i = 0; i < hosted->count; i++) {
+        checksum += hashCheckpointPart(hosted->firstPlayer + i, &hosted->players[i], sizeof(Player));
+    }
+    for (t = 0; t < hosted->tiles; t++) {
+        checksum += hashCheckpointPart(layout.players + hosted->firstTile + t,
+            hosted->storage + t * getTileBytes(), getTileBytes());
+    }
+    MPI_Reduce(&checksum, &total, 1, MPI_UINT64_T, MPI_SUM, 0, tournament.comm);
+
+    if (rank == 0) {
+        CheckpointHeader header;
+        fillCheckpointHeader(&header, round, seed);
+        header.checksum = total;
+        MPI_File_write_at(checkpoint->file, slot * checkpoint->slotBytes, &header, sizeof(CheckpointHeader),
+            MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    checkpoint->written++;
+}
+
+int restoreCheckpoint(Checkpoint *checkpoint, Hosted *hosted, Ball *ball) {
+    // Collective over the match communicator, returns the first round to play. Players
+    // stand where the checkpointed round left them, so the subfields are rebuilt from
+    // their records as at the start of a match and only the ball is taken from the
+    // subfield blocks
+    int slot = (checkpoint->written - 1) % CHECKPOINT_SLOTS;
+    int i, t;
+    MPI_File_read_at_all(checkpoint->file, getCheckpointPlayerOffset(slot, hosted->firstPlayer), hosted->players,
+        (int) (hosted->count * sizeof(Player)), MPI_BYTE, MPI_STATUS_IGNORE);
+    for (i = 0; i < hosted->count; i++) {
+        hosted->players[i].prevX = hosted->players[i].currX;
+        hosted->players[i].prevY = hosted->players[i].currY;
+    }
+
+    char *blocks = allocOrAbort((hosted->tiles > 0 ? hosted->tiles : 1) * getTileBytes());
+    int position[2] = {DO_NOT_EXIST, DO_NOT_EXIST};
+    MPI_File_read_at_all(checkpoint->file, getCheckpointTileOffset(slot, hosted->firstTile), blocks,
+        (int) (hosted->tiles * getTileBytes()), MPI_BYTE, MPI_STATUS_IGNORE);
+    for (t = 0; t < hosted->tiles; t++) {
+        Ball *saved = (Ball *) (blocks + t * getTileBytes());
+        if (saved->x != DO_NOT_EXIST && saved->y != DO_NOT_EXIST) {
+            position[0] = saved->x;
+            position[1] = saved->y;
+        }
+    }
+    free(blocks);
+    MPI_Allreduce(MPI_IN_PLACE, position, 2, MPI_INT, MPI_MAX, tournament.comm);
+    placeHostedBall(hosted, position);
+    ball->x = position[0];
+    ball->y = position[1];
+    return checkpoint->header.round + 1;
+}
+
+void closeCheckpoint(Checkpoint *checkpoint) {
+    MPI_File_close(&checkpoint->file);
+}
+
+/* =============== PLAYER FUNCTIONS ================*/
+void clearPlayerRoundData(Hosted *hosted) {
+    int i;
+    for (i = 0; i < hosted->count; i++) {
+        clearPlayerRound(&hosted->players[i]);
+    }
+}
+
+void movePlayersTowardsBall(Hosted *hosted, Ball *ball, int round, uint64_t seed) {
+    int i;
+    for (i = 0; i < hosted->count; i++) {
+        movePlayerTowardsBall(hosted->firstPlayer + i, ball, &hosted->players[i], round, seed);
+    }
+}
+
+/* =================== TOURNAMENT ===================*/
+void setupTournament(int worldRank, Options *options) {
+    // Consecutive processes play one match, so a match keeps to as few nodes as the
+    // machinefile allows
+    int procs;
+    MPI_Comm_size(MPI_COMM_WORLD, &procs);
+    tournament.active = options->matchRanks != 0 ? TRUE : FALSE;
+    tournament.matchRanks = tournament.active ? options->matchRanks : procs;
+    tournament.match = 0;
+    if (tournament.matchRanks < 1 || procs % tournament.matchRanks != 0) {
+        abortWithError(worldRank, "the number of processes must be a multiple of --match-ranks");
+    }
+    if (tournament.active && options->checkpointPath != NULL) {
+        abortWithError(worldRank, "a checkpoint holds a single match, it does not combine with --match-ranks");
+    }
+    tournament.matches = procs / tournament.matchRanks;
+    tournament.match = worldRank / tournament.matchRanks;
+    tournament.comm = MPI_COMM_WORLD;
+    if (tournament.active) {
+        MPI_Comm_split(MPI_COMM_WORLD, tournament.match, worldRank, &tournament.comm);
+    }
+}
+
+TraceWriter *openMatchTrace(Options *options) {
+    // Each match of a tournament writes a trace file of its own, suffixed with its index
+    if (!tournament.active) {
+        return traceOpen(options->tracePath, TRACE_MATCH, layout.players, 11);
+    }
+    char *path = allocOrAbort(strlen(options->tracePath) + 16);
+    sprintf(path, "%s.%d", options->tracePath, tournament.match);
+    TraceWriter *trace = traceOpen(path, TRACE_MATCH, layout.players, 11);
+    free(path);
+    return trace;
+}
+
+void addHostedStats(Hosted *hosted, Result *result) {
+    int i;
+    for (i = 0; i < hosted->count; i++) {
+        Player *player = &hosted->players[i];
+        result->speed[player->team] += player->speed;
+        result->dribble[player->team] += player->dribble;
+        result->kick[player->team] += player->kick;
+    }
+}
+
+void printSideSummary(Result *results) {
+    // Every match draws fresh rosters from its own seed, so team A of one match has nothing
+    // to do with team A of another. Summed over the matches the two sides only show whether
+    // one end of the field has the edge, this is not a league table of teams
+    int won[TEAMS] = {0, 0}, drawn[TEAMS] = {0, 0}, lost[TEAMS] = {0, 0};
+    int scored[TEAMS] = {0, 0}, conceded[TEAMS] = {0, 0};
+    int m, t;
+    for (m = 0; m < tournament.matches; m++) {
+        for (t = 0; t < TEAMS; t++) {
+            int own = results[m].goals[t];
+            int other = results[m].goals[1 - t];
+            scored[t] += own;
+            conceded[t] += other;
+            won[t] += own > other ? 1 : 0;
+            drawn[t] += own == other ? 1 : 0;
+            lost[t] += own < other ? 1 : 0;
+        }
+    }
+    for (t = 0; t < TEAMS; t++) {
+        fprintf(stderr, "side=%c played=%d won=%d drawn=%d lost=%d for=%d against=%d\n", t == TEAM_A ? 'A' : 'B',
+            tournament.matches, won[t], drawn[t], lost[t], scored[t], conceded[t]);
+    }
+}
+
+void reportTournament(int worldRank, Hosted *hosted, Result *result, uint64_t seed, double elapsed) {
+    // One reduction over every process fills the row of each match, processes of other
+    // matches add zeros. Prints one line per match in the format of match_ensemble:
+    // match seed goalsA goalsB passesA passesB shotsA shotsB outsA outsB
+    //       speedA speedB dribbleA dribbleB kickA kickB
+    addHostedStats(hosted, result);
+    Result *rows = allocOrAbort(tournament.matches * sizeof(Result));
+    Result *results = allocOrAbort(tournament.matches * sizeof(Result));
+    rows[tournament.match] = *result;
+    MPI_Reduce(rows, results, tournament.matches * (int) (sizeof(Result) / sizeof(int)), MPI_INT, MPI_SUM, 0,
+        MPI_COMM_WORLD);
+    double maxElapsed;
+    MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    // World process 0 plays match 0, so its seed is the one the others add their index to
+    int m;
+    if (worldRank == 0) {
+        for (m = 0; m < tournament.matches; m++) {
+            Result *row = &results[m];
+            printf("%d %" PRIu64 " %d %d %d %d %d %d %d %d %d %d %d %d %d %d\n", m, seed + m,
+                row->goals[TEAM_A], row->goals[TEAM_B], row->passes[TEAM_A], row->passes[TEAM_B],
+                row->shots[TEAM_A], row->shots[TEAM_B], row->outs[TEAM_A], row->outs[TEAM_B],
+                row->speed[TEAM_A], row->speed[TEAM_B], row->dribble[TEAM_A], row->dribble[TEAM_B],
+                row->kick[TEAM_A], row->kick[TEAM_B]);
+        }
+        printSideSummary(results);
+
+        // Launch to last whistle, so startup counts against the matches too
+        fprintf(stderr, "matches=%d procs/match=%d total=%.3fs matches/hour=%.1f\n", tournament.matches,
+            tournament.matchRanks, maxElapsed, tournament.matches / maxElapsed * 3600);
+    }
+    free(rows);
+    free(results);
+}
+
+/* =============== OPTIONS AND TIMING ===============*/
+int parseSize(const char *text, int *length, int *width) {
+    return sscanf(text, "%dx%d", length, width) == 2 ? TRUE : FALSE;
+}
+
+void parseOptions(int rank, int argc, char *argv[], Options *options) {
+    options->dataflow = FALSE;
+    options->pipeline = FALSE;
+    options->halo = FALSE;
+    options->hybrid = FALSE;
+    options->rma = FALSE;
+    options->sharedFields = FALSE;
+    options->delta = FALSE;
+    options->localKick = FALSE;
+    options->compact = FALSE;
+    options->timing = FALSE;
+    options->profile = FALSE;
+    options->hasSeed = FALSE;
+    options->tracePath = NULL;
+    options->checkpointPath = NULL;
+    options->checkpointEvery = CHECKPOINT_EVERY;
+    options->restart = FALSE;
+    options->balance = 0;
+    options->matchRanks = 0;
+    options->config = matchConfig;
+    options->fieldRanks = 0;
+    options->playerRanks = 0;
+
+    MatchConfig *config = &options->config;
+    int i;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dataflow") == 0) {
+            options->dataflow = TRUE;
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            options->pipeline = TRUE;
+        } else if (strcmp(argv[i], "--halo") == 0) {
+            options->halo = TRUE;
+        } else if (strcmp(argv[i], "--hybrid") == 0) {
+            options->hybrid = TRUE;
+        } else if (strcmp(argv[i], "--rma") == 0) {
+            options->rma = TRUE;
+        } else if (strcmp(argv[i], "--shared-fields") == 0) {
+            options->sharedFields = TRUE;
+        } else if (strcmp(argv[i], "--delta") == 0) {
+            options->delta = TRUE;
+        } else if (strcmp(argv[i], "--local-kick") == 0) {
+            options->localKick = TRUE;
+        } else if (strcmp(argv[i], "--compact") == 0) {
+            options->compact = TRUE;
+        } else if (strcmp(argv[i], "--timing") == 0) {
+            options->timing = TRUE;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            options->profile = TRUE;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options->hasSeed = TRUE;
+            options->seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options->tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            options->checkpointPath = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) {
+            options->checkpointEvery = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--restart") == 0) {
+            options->restart = TRUE;
+        } else if (strcmp(argv[i], "--balance") == 0 && i + 1 < argc) {
+            options->balance = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--match-ranks") == 0 && i + 1 < argc) {
+            options->matchRanks = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--field") == 0 && i + 1 < argc &&
+            parseSize(argv[i + 1], &config->fieldLength, &config->fieldWidth)) {
+            i++;
+        } else if (strcmp(argv[i], "--subfield") == 0 && i + 1 < argc &&
+            parseSize(argv[i + 1], &config->subfieldLength, &config->subfieldWidth)) {
+            i++;
+        } else if (strcmp(argv[i], "--team-size") == 0 && i + 1 < argc) {
+            config->playersPerTeam = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            config->rounds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--field-ranks") == 0 && i + 1 < argc) {
+            options->fieldRanks = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--player-ranks") == 0 && i + 1 < argc) {
+            options->playerRanks = atoi(argv[++i]);
+        } else {
+            if (rank == 0) {
+                fprintf(stderr, "Unknown option %s\nUsage: %s [--dataflow] [--pipeline] [--halo] [--hybrid] [--rma] [--shared-fields] [--delta] [--local-kick] [--compact] [--timing] [--profile] [--seed N] [--trace FILE]\n"
+                    "    [--field LxW] [--subfield LxW] [--team-size N] [--rounds N] [--field-ranks N] [--player-ranks N]\n"
+                    "    [--checkpoint FILE [--checkpoint-every N] [--restart]] [--balance N] [--match-ranks N]\n",
+                    argv[i], argv[0]);
+            }
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    // The pipelined, halo and delta schedules never synchronize beyond the data they
+    // exchange, the halo schedule replaces the pipelined one
+    if (options->halo) {
+        options->pipeline = FALSE;
+    }
+    if (options->pipeline || options->halo || options->delta) {
+        options->dataflow = TRUE;
+    }
+}
+
+void setupLayout(int rank, Options *options) {
+    // Every process parses the same arguments, so they all agree on the layout
+    const char *error = checkMatchConfig(&options->config);
+    if (error != NULL) {
+        abortWithError(rank, error);
+    }
+    matchConfig = options->config;
+
+    MPI_Comm_size(tournament.comm, &layout.procs);
+    layout.fields = getFieldCount();
+    layout.players = getPlayerCount();
+
+    // Without explicit counts the processes are split in proportion to the subfields and
+    // players they host, which gives 12 field and 22 player processes for the default
+    // match on 34 processes. A hybrid layout spreads both over as many processes as it
+    // can, so it runs on a single process and only splits roles once there are enough
+    layout.fieldRanks = options->fieldRanks;
+    layout.playerRanks = options->playerRanks;
+    if (options->hybrid) {
+        if (layout.fieldRanks <= 0) {
+            layout.fieldRanks = getMin(layout.fields, layout.procs);
+        }
+        if (layout.playerRanks <= 0) {
+            layout.playerRanks = getMin(layout.players, layout.procs);
+        }
+    } else if (layout.fieldRanks <= 0 && layout.playerRanks <= 0) {
+        int total = layout.fields + layout.players;
+        int share = (int) (((long) layout.procs * layout.fields * 2 + total) / (2 * total));
+        int most = getMin(layout.fields, layout.procs - 1);
+        layout.fieldRanks = share < 1 ? 1 : share > most ? most : share;
+    } else if (layout.fieldRanks <= 0) {
+        layout.fieldRanks = layout.procs - layout.playerRanks;
+    }
+    if (layout.playerRanks <= 0) {
+        layout.playerRanks = layout.procs - layout.fieldRanks;
+    }
+
+    layout.firstPlayerRank = layout.procs - layout.playerRanks;
+    if (options->hybrid ? layout.fieldRanks + layout.playerRanks < layout.procs :
+        layout.fieldRanks + layout.playerRanks != layout.procs) {
+        abortWithError(rank, options->hybrid ? "every process needs subfields or players to host" :
+            "field and player processes must add up to the number of processes");
+    }
+    if (layout.fieldRanks < 1 || layout.fieldRanks > layout.fields) {
+        abortWithError(rank, "every field process needs at least one subfield");
+    }
+    if (layout.playerRanks < 1 || layout.playerRanks > layout.players || layout.playerRanks > layout.procs) {
+        abortWithError(rank, "every player process needs at least one player");
+    }
+
+    // Subfields start out in contiguous blocks of about the same size
+    int f;
+    layout.tileStarts = allocOrAbort((layout.fieldRanks + 1) * sizeof(int));
+    layout.tileRanks = allocOrAbort(layout.fields * sizeof(int));
+    for (f = 0; f <= layout.fieldRanks; f++) {
+        layout.tileStarts[f] = getBlockStart(f, layout.fieldRanks, layout.fields);
+    }
+    setTileStarts(layout.tileStarts);
+    if (options->halo && (error = checkHaloLayout()) != NULL) {
+        abortWithError(rank, error);
+    }
+    if (options->rma && (options->pipeline || options->halo)) {
+        abortWithError(rank, "--rma replaces the player exchange of the barrier schedule, not --pipeline or --halo");
+    }
+    if (options->sharedFields && (options->pipeline || options->halo || options->rma)) {
+        abortWithError(rank, "--shared-fields only works with the barrier and dataflow schedules");
+    }
+    if (options->delta && (options->pipeline || options->halo || options->rma || options->sharedFields)) {
+        abortWithError(rank, "--delta is a schedule of its own, it does not combine with other transports");
+    }
+    if (options->localKick && (options->pipeline || options->halo || options->rma || options->delta)) {
+        abortWithError(rank, "--local-kick settles kicks from the gathered players, which only the barrier and dataflow schedules gather");
+    }
+    if (options->compact && (matchConfig.fieldLength >= WIRE_COORD_LIMIT || matchConfig.fieldWidth >= WIRE_COORD_LIMIT)) {
+        abortWithError(rank, "--compact packs coordinates into 12 bits, the field is too large for it");
+    }
+    if (options->balance < 0 || (options->balance > 0 &&
+        (options->halo || options->rma || options->sharedFields || options->delta))) {
+        abortWithError(rank, "--balance moves subfields between processes, which --halo, --rma, --shared-fields and --delta keep in place");
+    }
+    if (options->checkpointEvery < 1 || (options->restart && options->checkpointPath == NULL)) {
+        abortWithError(rank, "checkpoints need a file and a positive interval");
+    }
+}
+
+uint64_t shareSeed(int rank, Options *options) {
+    // Without --seed, one process picks a seed from the clock and reports it so the run
+    // can be reproduced, every process then draws from the same seed. Match m of a
+    // tournament plays with seed + m, like match m of match_ensemble
+    uint64_t seed = options->hasSeed ? options->seed : (uint64_t) time(0);
+    MPI_Bcast(&seed, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    if (rank == 0 && tournament.match == 0 && !options->hasSeed) {
+        fprintf(stderr, "seed=%" PRIu64 "\n", seed);
+    }
+    return seed + tournament.match;
+}
+
+void printRoundTiming(int rank, Options *options, int rounds, double elapsed, double slowestRound) {
+    // A round is only as fast as the slowest process, so report the maximum over all ranks
+    double maxElapsed, maxSlowestRound;
+    MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, tournament.comm);
+    MPI_Reduce(&slowestRound, &maxSlowestRound, 1, MPI_DOUBLE, MPI_MAX, 0, tournament.comm);
+
+    if (rank == 0 && tournament.match == 0) {
+        fprintf(stderr, "schedule=%s%s%s%s%s procs=%d subfields=%d/%d players=%d/%d rounds=%d total=%.3fs round mean=%.1fus max=%.1fus\n",
+            options->halo ? "halo" : options->pipeline ? "pipeline" : options->rma ? "rma" :
+            options->delta ? "delta" :
+            options->dataflow ? "dataflow" : "barrier",
+            options->hybrid ? "/hybrid" : "", options->sharedFields ? "/shared" : "", options->localKick ? "/local" : "",
+            options->compact ? "/compact" : "",
+            layout.procs, layout.fields, layout.fieldRanks, layout.players, layout.playerRanks, rounds, maxElapsed,
+            maxElapsed / rounds * 1e6, maxSlowestRound * 1e6);
+    }
+}
+
+/* ======================== MAIN =========================*/
+int main(int argc, char *argv[]) {
+    // MPI Initialization
+    int worldRank, rank, commRank, commSize;
+
+    // Only the main thread makes MPI calls, the trace writer thread never does
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &worldRank);
+    double launchStart = MPI_Wtime();
+
+    // In dataflow mode processes only synchronize through the data they exchange. From
+    // here on rank is the rank within the match
+    Options options;
+    parseOptions(worldRank, argc, argv, &options);
+    setupTournament(worldRank, &options);
+    MPI_Comm_rank(tournament.comm, &rank);
+    setupLayout(rank, &options);
+
+    // Field process 0 hands every round to a writer thread instead of printing it, in a
+    // tournament only with --trace
+    TraceWriter *trace = NULL;
+    if (rank == 0 && (!tournament.active || options.tracePath != NULL)) {
+        trace = openMatchTrace(&options);
+        if (trace == NULL) {
+            fprintf(stderr, "Cannot open trace file %s\n", options.tracePath);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    createPlayerType();
+    createKickClaimOp();
+
+    // A restarted match plays on with the seed of its checkpoint
+    Checkpoint checkpoint;
+    if (options.checkpointPath != NULL) {
+        openCheckpoint(rank, &options, &checkpoint);
+    }
+    uint64_t seed = shareSeed(rank, &options);
+
+    // Split processes into appropriate communicators
+    MPI_Comm COMM;
+    MPI_Comm_split(tournament.comm, isField(rank) ? COMM_FIELDS : COMM_PLAYERS, rank, &COMM);
+    MPI_Comm_rank(COMM, &commRank);
+    MPI_Comm_size(COMM, &commSize);
+
+    // In the halo schedule a field process stands for the subfield the Cartesian grid
+    // gives it, which need not match its rank
+    Halo halo;
+    int firstTile = getFirstTile(rank);
+    if (options.halo) {
+        initHalo(rank, COMM, &halo);
+        firstTile = isField(rank) ? halo.tile : firstTile;
+    }
+
+    // Field processes on one node can keep their subfields in a shared segment instead
+    SharedFields shared;
+    char *storage = NULL;
+    MPI_Comm gatherComm = tournament.comm;
+    if (options.sharedFields) {
+        initSharedFields(rank, COMM, &shared);
+        storage = shared.storage;
+        gatherComm = shared.gather;
+    }
+
+    // Initialize private data for each of the processes
+    Hosted hosted;
+    Ball ball;
+    initHosted(rank, firstTile, &hosted, storage, seed);
+    if (options.sharedFields) {
+        buildNodeView(&shared);
+    }
+    int firstRound = 0;
+    if (options.restart) {
+        firstRound = restoreCheckpoint(&checkpoint, &hosted, &ball);
+    }
+    Balance balance;
+    if (options.balance > 0) {
+        initBalance(options.balance, &balance);
+    }
+
+    // Set up the collectives repeated every round, a process sharing its leader's records
+    // reads the gathered players from there
+    Player *privatePlayers = allocOrAbort(layout.players * sizeof(Player));
+    Player *players = options.sharedFields && shared.records != NULL ? shared.records : privatePlayers;
+    RoundCollectives collectives;
+    Result result;
+    memset(&result, 0, sizeof(Result));
+    initWire(options.compact, &hosted);
+    initRoundCollectives(&collectives, &hosted, players, gatherComm);
+
+    // Wait for all initializations to finish
+    if (!options.dataflow) {
+        waitBarrier(&collectives);
+    }
+    // printField(hosted.firstTile, &hosted.fields[0]);
+
+    // Exchange all player initial records and hand them to subfields
+    Rma rma;
+    if (options.rma) {
+        initRma(&hosted, &rma);
+        exchangeInitialRecords(&rma, &hosted);
+    } else {
+        gatherPlayers(&collectives, &hosted);
+        if (options.sharedFields) {
+            syncNodeFields(rank, &shared);
+        }
+        updatePlayerPositions(&hosted, players);
+        updatePlayerData(&hosted, players);
+    }
+    Delta delta;
+    if (options.delta) {
+        initDelta(rank, COMM, &hosted, &delta);
+    }
+
+    // Phases a process takes no part in are not charged to it
+    Profile profile;
+    profileInit(&profile, options.profile, phases, PHASES, tournament.comm);
+    int fieldPhase = isField(rank) ? TRUE : FALSE;
+    int playerPhase = hostsPlayers(rank) ? TRUE : FALSE;
+
+    // The pipelined schedule carries the ball position from one round to the next, so it
+    // is only broadcast by the fields once
+    OutputGather output;
+    initOutputGather(&output);
+    if (options.sharedFields && isField(rank)) {
+        routeOutputThroughLeaders(&shared, COMM, &output);
+    }
+    if (options.pipeline) {
+        broadcastBallPosition(rank, &hosted, &ball, &collectives);
+    }
+
+    // The halo and delta schedules also carry it, and every process knows the match starts
+    // with the ball in the center or where the checkpoint left it
+    PassIndex passIndex;
+    initPassIndex(&passIndex);
+    int *startTiles = allocOrAbort((hosted.count > 0 ? hosted.count : 1) * sizeof(int));
+    MPI_Request *recordRequests = allocOrAbort((hosted.count > 0 ? hosted.count : 1) * sizeof(MPI_Request));
+    int newPosition[2];
+    if ((options.halo || options.delta) && !options.restart) {
+        ball.x = matchConfig.fieldLength / 2;
+        ball.y = matchConfig.fieldWidth / 2;
+    }
+
+    // Run for n rounds
+    int r, i;
+    double loopStart = MPI_Wtime();
+    double slowestRound = 0;
+    for (r = firstRound; r < matchConfig.rounds; r++) {
+        double roundStart = MPI_Wtime();
+        profileMark(&profile, PROFILE_NO_PHASE);
+
+        if (options.halo) {
+            // Each player reports to the subfield it starts the round in, fields then hand
+            // players on to their neighbours and only the ball subfield resolves the kick.
+            // A hybrid process plays its players first, then its subfield
+            if (playerPhase) {
+                for (i = 0; i < hosted.count; i++) {
+                    startTiles[i] = getFieldRankFromCoords(hosted.players[i].currX, hosted.players[i].currY);
+                }
+                clearPlayerRoundData(&hosted);
+                movePlayersTowardsBall(&hosted, &ball, r, seed);
+                profileMark(&profile, PHASE_MOVE);
+                startPlayerRecords(&halo, &hosted, startTiles, recordRequests);
+            }
+            if (fieldPhase) {
+                Field *field = &hosted.fields[0];
+                receivePlayerRecords(&halo, field);
+                profileMark(&profile, PHASE_GATHER_PLAYERS);
+                migratePlayers(&halo, field);
+                profileMark(&profile, PHASE_MIGRATE_PLAYERS);
+                exchangeKickPositions(&halo, field, &ball, &passIndex);
+                profileMark(&profile, PHASE_EXCHANGE_HALO);
+                resolveKick(&halo, field, &ball, &passIndex, r, seed, newPosition, &result);
+                profileMark(&profile, PHASE_KICK_BALL);
+            }
+            if (playerPhase) {
+                MPI_Waitall(hosted.count, recordRequests, MPI_STATUSES_IGNORE);
+                profileMark(&profile, PHASE_GATHER_PLAYERS);
+            }
+            shareKickedBall(&halo, &hosted, &ball, newPosition);
+            profileMark(&profile, PHASE_UPDATE_BALL);
+
+            if (isField(rank)) {
+                if (r > firstRound) {
+                    finishRoundOutput(rank, &output, trace);
+                }
+                startOwnedOutput(&hosted, COMM, &output, r);
+                profileMark(&profile, PHASE_GATHER_OUTPUT);
+            }
+        } else if (options.delta) {
+            // Each player claims the ball and reports to the process owning it, fields only
+            // exchange the players and the ball that changed owner. A hybrid process plays
+            // its players first, then its subfields
+            clearPlayerRoundData(&hosted);
+            movePlayersTowardsBall(&hosted, &ball, r, seed);
+            makeHostedKickClaim(&hosted, r, seed, &collectives.claim);
+            profileMark(&profile, playerPhase ? PHASE_MOVE : PROFILE_NO_PHASE);
+            if (playerPhase) {
+                startOwnerRecords(&hosted, recordRequests);
+            }
+            if (fieldPhase) {
+                receiveOwnedRecords(&delta, &hosted);
+            }
+            if (playerPhase) {
+                MPI_Waitall(hosted.count, recordRequests, MPI_STATUSES_IGNORE);
+            }
+            profileMark(&profile, PHASE_GATHER_PLAYERS);
+
+            startClaimReduction(&collectives);
+            MPI_Wait(&collectives.claimRequest, MPI_STATUS_IGNORE);
+            markHostedKicker(&hosted, &collectives.winner);
+            markFieldKicker(&hosted, &collectives.winner);
+            profileMark(&profile, PHASE_DETERMINE_KICKER);
+            collectKickPositions(rank, &delta, &hosted, &collectives.winner, &passIndex);
+            profileMark(&profile, PHASE_FETCH_POSITIONS);
+            int ballRank = getOwnerRank(ball.x, ball.y);
+            kickBall(&hosted, &passIndex, &ball, r, seed, &result);
+            profileMark(&profile, playerPhase ? PHASE_KICK_BALL : PROFILE_NO_PHASE);
+            handOverKickedBall(rank, &delta, &hosted, &collectives.winner, &ball, ballRank);
+            profileMark(&profile, PHASE_UPDATE_BALL);
+
+            if (isField(rank)) {
+                exchangeDeltas(&delta, &hosted);
+                profileMark(&profile, PHASE_EXCHANGE_DELTAS);
+                if (r > firstRound) {
+                    finishRoundOutput(rank, &output, trace);
+                }
+                startOwnedOutput(&hosted, COMM, &output, r);
+                profileMark(&profile, PHASE_GATHER_OUTPUT);
+            }
+        } else if (options.pipeline) {
+            // Players move and claim the ball straight away, the claim only depends on
+            // their own state
+            clearPlayerRoundData(&hosted);
+            movePlayersTowardsBall(&hosted, &ball, r, seed);
+            makeHostedKickClaim(&hosted, r, seed, &collectives.claim);
+            profileMark(&profile, playerPhase ? PHASE_MOVE : PROFILE_NO_PHASE);
+
+            exchangeRoundClaims(&hosted, players, &collectives);
+            profileMark(&profile, PHASE_GATHER_PLAYERS);
+            indexPlayers(&hosted, players, &passIndex);
+            kickBall(&hosted, &passIndex, &ball, r, seed, &result);
+            profileMark(&profile, playerPhase ? PHASE_KICK_BALL : PROFILE_NO_PHASE);
+
+            // Field processes take over the new records while the ball position travels
+            startBallBroadcast(rank, &ball, &collectives);
+            updatePlayerPositions(&hosted, players);
+            profileMark(&profile, fieldPhase ? PHASE_UPDATE_POSITIONS : PROFILE_NO_PHASE);
+            updatePlayerData(&hosted, players);
+            profileMark(&profile, fieldPhase ? PHASE_UPDATE_DATA : PROFILE_NO_PHASE);
+            finishBallBroadcast(rank, &hosted, &ball, &collectives);
+            profileMark(&profile, PHASE_UPDATE_BALL);
+
+            // The output of the previous round had this whole round to arrive, the output
+            // of this round gets the next one
+            if (isField(rank)) {
+                if (r > firstRound) {
+                    finishRoundOutput(rank, &output, trace);
+                }
+                startRoundOutput(&hosted, players, COMM, &output, r);
+                profileMark(&profile, PHASE_GATHER_OUTPUT);
+            }
+        } else if (options.rma) {
+            // Players claim the ball as soon as they moved and put their final records
+            // straight into the fields that own them, the fences take the place of the
+            // barriers and both player gathers
+            clearPlayerRoundData(&hosted);
+            broadcastBallPosition(rank, &hosted, &ball, &collectives);
+            profileMark(&profile, PHASE_BROADCAST_BALL);
+            movePlayersTowardsBall(&hosted, &ball, r, seed);
+            makeHostedKickClaim(&hosted, r, seed, &collectives.claim);
+            profileMark(&profile, playerPhase ? PHASE_MOVE : PROFILE_NO_PHASE);
+            putPlayerRecords(&rma, &hosted);
+            syncPlayerRecords(&rma, &hosted);
+            profileMark(&profile, PHASE_PUT_RECORDS);
+
+            startClaimReduction(&collectives);
+            MPI_Wait(&collectives.claimRequest, MPI_STATUS_IGNORE);
+            markHostedKicker(&hosted, &collectives.winner);
+            markFieldKicker(&hosted, &collectives.winner);
+            profileMark(&profile, PHASE_DETERMINE_KICKER);
+            fetchKickPositions(rank, &rma, &collectives.winner, &passIndex);
+            profileMark(&profile, PHASE_FETCH_POSITIONS);
+            kickBall(&hosted, &passIndex, &ball, r, seed, &result);
+            profileMark(&profile, playerPhase ? PHASE_KICK_BALL : PROFILE_NO_PHASE);
+            updateBallPosition(rank, &hosted, &ball, &collectives);
+            profileMark(&profile, PHASE_UPDATE_BALL);
+
+            if (isField(rank)) {
+                startOwnedOutput(&hosted, COMM, &output, r);
+                finishRoundOutput(rank, &output, trace);
+                profileMark(&profile, PHASE_GATHER_OUTPUT);
+            }
+        } else {
+            clearPlayerRoundData(&hosted);
+            broadcastBallPosition(rank, &hosted, &ball, &collectives);
+            profileMark(&profile, PHASE_BROADCAST_BALL);
+            movePlayersTowardsBall(&hosted, &ball, r, seed);
+            profileMark(&profile, playerPhase ? PHASE_MOVE : PROFILE_NO_PHASE);
+
+            // Wait for all player movement to finish, the player gather below already
+            // waits for every player in dataflow mode
+            if (!options.dataflow) {
+                waitBarrier(&collectives);
+                profileMark(&profile, PHASE_BARRIER);
+            }
+
+            // Update all the new player positions and round data, with shared fields the
+            // leaders gathered them for their whole node
+            gatherPlayers(&collectives, &hosted);
+            if (options.sharedFields) {
+                syncNodeFields(rank, &shared);
+            }
+            profileMark(&profile, PHASE_GATHER_PLAYERS);
+            updatePlayerPositions(&hosted, players);
+            profileMark(&profile, fieldPhase ? PHASE_UPDATE_POSITIONS : PROFILE_NO_PHASE);
+            updatePlayerData(&hosted, players);
+            profileMark(&profile, fieldPhase ? PHASE_UPDATE_DATA : PROFILE_NO_PHASE);
+
+            // Handle ball kick, locally only the processes around the ball take part
+            int ballRank = DO_NOT_EXIST;
+            if (options.localKick) {
+                ballRank = determineLocalKicker(&hosted, players, r, seed, &collectives.winner);
+            } else {
+                determineKicker(&hosted, r, seed, &collectives);
+            }
+            profileMark(&profile, PHASE_DETERMINE_KICKER);
+            indexPlayers(&hosted, players, &passIndex);
+            kickBall(&hosted, &passIndex, &ball, r, seed, &result);
+            profileMark(&profile, playerPhase ? PHASE_KICK_BALL : PROFILE_NO_PHASE);
+            if (options.localKick) {
+                publishKickedBall(rank, &hosted, &ball, ballRank, COMM);
+            } else {
+                updateBallPosition(rank, &hosted, &ball, &collectives);
+            }
+            profileMark(&profile, PHASE_UPDATE_BALL);
+
+            // Ensure field is updated before proceeding to next round. The leader only
+            // gathers again after the claim reduction, which every field on the node joins
+            // once it is done reading the previous records
+            gatherPlayers(&collectives, &hosted);
+            if (options.sharedFields) {
+                syncNodeFields(rank, &shared);
+            }
+            profileMark(&profile, PHASE_GATHER_PLAYERS);
+            updatePlayerData(&hosted, players);
+            profileMark(&profile, fieldPhase ? PHASE_UPDATE_DATA : PROFILE_NO_PHASE);
+            if (!options.dataflow) {
+                waitBarrier(&collectives);
+                profileMark(&profile, PHASE_BARRIER);
+            }
+            // printField(hosted.firstTile, &hosted.fields[0]);
+
+            // Gather all the field data in field process 0 for output, which includes
+            // waiting for a free trace buffer there. Leaders send for their whole node once
+            // every field on it is done, and only gather players again after that
+            if (options.sharedFields) {
+                syncNodeFields(rank, &shared);
+                if (shared.leader) {
+                    gatherRoundOutput(rank, &shared.view, players, shared.leaders, &output, r, trace);
+                }
+                profileMark(&profile, PHASE_GATHER_OUTPUT);
+            } else if (isField(rank)) {
+                gatherRoundOutput(rank, &hosted, players, COMM, &output, r, trace);
+                profileMark(&profile, PHASE_GATHER_OUTPUT);
+            }
+        }
+
+        // Subfields change hands between rounds, after the fields weighed them. Pipelined
+        // output still in flight only depends on buffers of its own, as do checkpoints
+        if (options.balance > 0) {
+            if (isField(rank)) {
+                recordOccupancy(&balance, &hosted);
+            }
+            if ((r + 1) % balance.every == 0 && r + 1 < matchConfig.rounds) {
+                balanceSubfields(rank, &balance, &hosted, COMM);
+                profileMark(&profile, PHASE_BALANCE_SUBFIELDS);
+            }
+        }
+        if (options.checkpointPath != NULL && (r + 1) % checkpoint.every == 0 && r + 1 < matchConfig.rounds) {
+            writeCheckpoint(rank, &checkpoint, &hosted, r, seed);
+            profileMark(&profile, PHASE_WRITE_CHECKPOINT);
+        }
+        profileEndRound(&profile);
+
+        double roundTime = MPI_Wtime() - roundStart;
+        if (roundTime > slowestRound) {
+            slowestRound = roundTime;
+        }
+    }
+
+    if ((options.pipeline || options.halo || options.delta) && isField(rank)) {
+        finishRoundOutput(rank, &output, trace);
+    }
+
+    if (options.timing) {
+        printRoundTiming(rank, &options, matchConfig.rounds - firstRound, MPI_Wtime() - loopStart, slowestRound);
+    }
+    if (tournament.match == 0) {
+        profileReport(&profile, rank, 0, tournament.comm);
+    }
+
+    if (trace != NULL && traceClose(trace) != 0) {
+        fprintf(stderr, "Failed to write round output\n");
+    }
+    if (tournament.active) {
+        reportTournament(worldRank, &hosted, &result, seed, MPI_Wtime() - launchStart);
+    }
+
+    freeRoundCollectives(&collectives);
+    freeWire();
+    if (options.halo) {
+        freeHalo(rank, &halo);
+    }
+    if (options.rma) {
+        freeRma(&rma);
+    }
+    if (options.delta) {
+        freeDelta(&delta);
+    }
+    if (options.checkpointPath != NULL) {
+        closeCheckpoint(&checkpoint);
+    }
+    if (options.balance > 0) {
+        freeBalance(&balance);
+    }
+    freeOutputGather(&output);
+    freeHosted(&hosted);
+    if (options.sharedFields) {
+        freeSharedFields(&shared);
+    }
+    free(privatePlayers);
+    freePassIndex(&passIndex);
+    free(startTiles);
+    free(recordRequests);
+    free(layout.tileStarts);
+    free(layout.tileRanks);
+    MPI_Comm_free(&COMM);
+    if (tournament.active) {
+        MPI_Comm_free(&tournament.comm);
+    }
+    MPI_Op_free(&kickClaimOp);
+    MPI_Type_free(&kickClaimType);
+    MPI_Type_free(&playerType);
+    MPI_Finalize();
+
+    return 0;
+}
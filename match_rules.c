@@ -0,0 +1,469 @@
+#include <stdlib.h>
+
+#include "match_rules.h"
+#include "rng.h"
+
+MatchConfig matchConfig = {
+    FIELD_LENGTH, FIELD_WIDTH, SUBFIELD_LENGTH, SUBFIELD_WIDTH, PLAYERS_PER_TEAM, ROUNDS
+};
+
+/* ===================== CONFIG =====================*/
+const char *checkMatchConfig(MatchConfig *config) {
+    // The goal mouth keeps its default size, so the pitch must be wide enough to hold it
+    if (config->fieldLength < 2 || config->fieldWidth < FIELD_WIDTH - 2 * GOAL_LEFT_START_Y + 2) {
+        return "field too small for the goals";
+    }
+    if (config->subfieldLength < 1 || config->subfieldWidth < 1 ||
+        config->subfieldLength > config->fieldLength || config->subfieldWidth > config->fieldWidth) {
+        return "subfield must fit in the field";
+    }
+    if (config->playersPerTeam < 1) {
+        return "teams need at least one player";
+    }
+    if (config->rounds < 1) {
+        return "a match needs at least one round";
+    }
+    return NULL;
+}
+
+int getSubfieldColumns() {
+    return (matchConfig.fieldLength + matchConfig.subfieldLength - 1) / matchConfig.subfieldLength;
+}
+
+int getSubfieldRows() {
+    return (matchConfig.fieldWidth + matchConfig.subfieldWidth - 1) / matchConfig.subfieldWidth;
+}
+
+int getFieldCount() {
+    return getSubfieldColumns() * getSubfieldRows();
+}
+
+int getPlayerCount() {
+    return TEAMS * matchConfig.playersPerTeam;
+}
+
+// The goal mouth keeps its default size and stays centred on the goal lines
+int getGoalStartY() {
+    return matchConfig.fieldWidth / 2 - (FIELD_WIDTH / 2 - GOAL_LEFT_START_Y);
+}
+
+int getGoalEndY() {
+    return matchConfig.fieldWidth / 2 + (GOAL_LEFT_END_Y - FIELD_WIDTH / 2);
+}
+
+/* ===================== UTILS =====================*/
+int getFieldRankFromCoords(int x, int y) {
+    if (x == DO_NOT_EXIST || y == DO_NOT_EXIST) {
+        return DO_NOT_EXIST;
+    }
+
+    int numCols = getSubfieldColumns();
+    int row = y / matchConfig.subfieldWidth;
+    int col = x / matchConfig.subfieldLength;
+    // printf("row=%d, col=%d\n", row, col);
+    return col + row * numCols;
+}
+
+int getDistanceBetweenPoints(int x1, int y1, int x2, int y2) {
+    int horizontalDistance = abs(x1 - x2);
+    int verticalDistance = abs(y1 - y2);
+    return horizontalDistance + verticalDistance;
+}
+
+int bothPointsInRange(int x1, int y1, int x2, int y2, int distance) {
+    return getDistanceBetweenPoints(x1, y1, x2, y2) <= distance ? TRUE : FALSE;
+}
+
+int getScoringDirection(Player *player, int round) {
+    int scoreDirectionA = round < matchConfig.rounds / 2 ? RIGHT : LEFT;
+    int scoreDirectionB = scoreDirectionA == RIGHT ? LEFT : RIGHT;
+    return player->team == TEAM_A ? scoreDirectionA : scoreDirectionB;
+}
+
+int getMin(int value1, int value2) {
+    return value2 < value1 ? value2 : value1;
+}
+
+int kickClaimBeats(KickClaim *claim, KickClaim *other) {
+    // Highest challenge wins, ties go to the highest key and then to the lowest player index
+    if (claim->challenge != other->challenge) {
+        return claim->challenge > other->challenge ? TRUE : FALSE;
+    }
+    if (claim->key != other->key) {
+        return claim->key > other->key ? TRUE : FALSE;
+    }
+    return claim->player < other->player ? TRUE : FALSE;
+}
+
+int getDistanceToGoal(int x, int y, int scoringDirection) {
+    // Distance to the nearer post of the goal a player attacks
+    int goalX = scoringDirection == LEFT ? GOAL_LEFT_START_X : matchConfig.fieldLength - 1;
+    return getMin(getDistanceBetweenPoints(goalX, getGoalStartY(), x, y),
+        getDistanceBetweenPoints(goalX, getGoalEndY(), x, y));
+}
+
+int goalScored(Ball *ball, Player *player, int round) {
+    // For now ignore own goals, should not happen anyway
+    int scoringDirection = getScoringDirection(player, round);
+    int scoredAtLeft = 
+        ball->x < GOAL_LEFT_START_X && 
+        ball->y >= getGoalStartY() && 
+        ball->y <= getGoalEndY();
+    int scoredAtRight =
+        ball->x > matchConfig.fieldLength - 1 &&
+        ball->y >= getGoalStartY() && 
+        ball->y <= getGoalEndY();
+
+    return scoredAtLeft || scoredAtRight ? TRUE : FALSE;
+}
+
+/* ===================== RULES =====================*/
+void initPlayerState(int index, Player *player, uint64_t seed) {
+    RngBlock draws = rngBlock(seed, RNG_NO_ROUND, index, RNG_INIT_PLAYER);
+
+    // Initialize player positions randomly
+    player->currX = player->prevX = rngBelow(draws.v[0], matchConfig.fieldLength);
+    player->currY = player->prevY = rngBelow(draws.v[1], matchConfig.fieldWidth);
+    player->team = index < matchConfig.playersPerTeam ? TEAM_A : TEAM_B;
+    player->reached = PLAYER_NO_REACHED_BALL;
+    player->kicked = PLAYER_NO_KICKED_BALL;
+    player->challenge = PLAYER_NO_CHALLENGE;
+
+    // Initialize player stats randomly
+    player->speed = player->dribble = player->kick = 1;
+
+    int stats = PLAYER_ALL_MAX;
+    stats -= (player->speed + player->dribble + player->kick);
+    int increment;
+    increment = rngBelow(draws.v[2], PLAYER_STAT_MAX);
+    player->speed += increment;
+    stats -= increment;
+    increment = rngBelow(draws.v[3], stats);
+    player->dribble += increment;
+    stats -= increment;
+    player->kick += stats;
+}
+
+void clearPlayerRound(Player *player) {
+    player->reached = PLAYER_NO_REACHED_BALL;
+    player->kicked = PLAYER_NO_KICKED_BALL;
+    player->challenge = PLAYER_NO_CHALLENGE;
+}
+
+void movePlayerTowardsBall(int index, Ball *ball, Player *player, int round, uint64_t seed) {
+    // Movement rules
+    // 1. Stop when ball is reached, or
+    // 2. Moved n squares, where n = speed skill
+    // 3. Always in the direction of the ball
+
+    // If the ball is within player->speed squares, move the player to the same square as the ball
+    if (bothPointsInRange(ball->x, ball->y, player->currX, player->currY, player->speed)) {
+        player->prevX = player->currX;
+        player->prevY = player->currY;
+        player->currX = ball->x;
+        player->currY = ball->y;
+        player->reached = 1;
+        return;
+    }
+
+    // Determine direction to travel towards ball, and move a random combined distance of
+    // player->speed squares in both directions
+    int horizontalDirection = (ball->x - player->currX) > 0 ? RIGHT : LEFT;
+    int verticalDirection = (ball->y - player->currY) > 0 ? UP : DOWN;
+    RngBlock draws = rngBlock(seed, round, index, RNG_MOVE);
+    int horizontalDistance = rngBelow(draws.v[0], player->speed + 1);
+    int verticalDistance = player->speed - horizontalDistance;
+    player->prevX = player->currX;
+    player->prevY = player->currY;
+    player->currX += horizontalDistance * horizontalDirection;
+    player->currY += verticalDistance * verticalDirection;
+
+    // Make sure the player does not go out of bounds
+    if (player->currX < 0) {
+        player->currX = 0;
+    }
+    if (player->currY < 0) {
+        player->currY = 0;
+    }
+    if (player->currX >= matchConfig.fieldLength) {
+        player->currX = matchConfig.fieldLength - 1;
+    }
+    if (player->currY >= matchConfig.fieldWidth) {
+        player->currY = matchConfig.fieldWidth - 1;
+    }
+
+    // printf("player %d (%d, %d) => (%d, %d) with speed=%d\n", index, player->prevX, player->prevY, player->currX, player->currY, player->speed);
+}
+
+void movePlayerLanes(MoveLanes *lanes, int count, int index, int round) {
+    // Same rule as movePlayerTowardsBall, applied to one player index in every lane
+    int maxX = matchConfig.fieldLength - 1;
+    int maxY = matchConfig.fieldWidth - 1;
+    int m;
+    for (m = 0; m < count; m++) {
+        int ballX = lanes->ballX[m];
+        int ballY = lanes->ballY[m];
+        int currX = lanes->currX[m];
+        int currY = lanes->currY[m];
+        int speed = lanes->speed[m];
+
+        lanes->prevX[m] = currX;
+        lanes->prevY[m] = currY;
+        if (bothPointsInRange(ballX, ballY, currX, currY, speed)) {
+            lanes->currX[m] = ballX;
+            lanes->currY[m] = ballY;
+            lanes->reached[m] = PLAYER_REACHED_BALL;
+            continue;
+        }
+
+        int horizontalDirection = (ballX - currX) > 0 ? RIGHT : LEFT;
+        int verticalDirection = (ballY - currY) > 0 ? UP : DOWN;
+        RngBlock draws = rngBlock(lanes->seeds[m], round, index, RNG_MOVE);
+        int horizontalDistance = rngBelow(draws.v[0], speed + 1);
+        int verticalDistance = speed - horizontalDistance;
+        currX += horizontalDistance * horizontalDirection;
+        currY += verticalDistance * verticalDirection;
+
+        // Make sure the player does not go out of bounds
+        lanes->currX[m] = currX < 0 ? 0 : currX > maxX ? maxX : currX;
+        lanes->currY[m] = currY < 0 ? 0 : currY > maxY ? maxY : currY;
+    }
+}
+
+void makeKickClaim(int index, Player *player, int round, uint64_t seed, KickClaim *claim) {
+    // Determine the ball challenge
+    if (player->reached == PLAYER_REACHED_BALL) {
+        RngBlock draws = rngBlock(seed, round, index, RNG_CHALLENGE);
+        player->challenge = (1 + rngBelow(draws.v[0], 10)) * player->dribble;
+    }
+    claim->challenge = player->challenge;
+    claim->key = rngBlock(seed, round, index, RNG_TIE_BREAK).v[0] & 0x7FFFFFFF;
+    claim->player = index;
+    claim->x = player->currX;
+    claim->y = player->currY;
+}
+
+/* =================== PASS INDEX ===================*/
+void initPassIndex(PassIndex *index) {
+    int cells, i;
+    index->columns = (matchConfig.fieldLength + KICK_RANGE_MAX - 1) / KICK_RANGE_MAX;
+    index->rows = (matchConfig.fieldWidth + KICK_RANGE_MAX - 1) / KICK_RANGE_MAX;
+    cells = TEAMS * index->columns * index->rows;
+    index->heads = malloc(cells * sizeof(int));
+    index->next = malloc(getPlayerCount() * sizeof(int));
+    index->cells = malloc(getPlayerCount() * sizeof(int));
+    index->positions = malloc(getPlayerCount() * sizeof(int[2]));
+    index->members = malloc(getPlayerCount() * sizeof(int));
+    index->count = 0;
+    for (i = 0; i < cells; i++) {
+        index->heads[i] = DO_NOT_EXIST;
+    }
+    for (i = 0; i < getPlayerCount(); i++) {
+        index->cells[i] = DO_NOT_EXIST;
+    }
+}
+
+void freePassIndex(PassIndex *index) {
+    free(index->heads);
+    free(index->next);
+    free(index->cells);
+    free(index->positions);
+    free(index->members);
+}
+
+void clearPassIndex(PassIndex *index) {
+    // Only touches the cells of the players placed since the last clear
+    int i;
+    for (i = 0; i < index->count; i++) {
+        int player = index->members[i];
+        index->heads[index->cells[player]] = DO_NOT_EXIST;
+        index->cells[player] = DO_NOT_EXIST;
+    }
+    index->count = 0;
+}
+
+void unlinkFromPassIndex(PassIndex *index, int player) {
+    int *link = &index->heads[index->cells[player]];
+    while (*link != player) {
+        link = &index->next[*link];
+    }
+    *link = index->next[player];
+}
+
+void placeInPassIndex(PassIndex *index, int player, int x, int y) {
+    // Cells are kept per team, team A holds the lower player indices
+    int team = player < matchConfig.playersPerTeam ? TEAM_A : TEAM_B;
+    int cell = (team * index->rows + y / KICK_RANGE_MAX) * index->columns + x / KICK_RANGE_MAX;
+    index->positions[player][0] = x;
+    index->positions[player][1] = y;
+    if (index->cells[player] == cell) {
+        return;
+    }
+    if (index->cells[player] == DO_NOT_EXIST) {
+        index->members[index->count++] = player;
+    } else {
+        unlinkFromPassIndex(index, player);
+    }
+    index->cells[player] = cell;
+    index->next[player] = index->heads[cell];
+    index->heads[cell] = player;
+}
+
+int isPassTarget(Player *player, int x, int y, int round) {
+    // Only pass to a teammate within kick range that is closer to the goal
+    int scoringDirection = getScoringDirection(player, round);
+    return
+        bothPointsInRange(player->currX, player->currY, x, y, player->kick * 2) &&
+        getDistanceToGoal(x, y, scoringDirection) <
+        getDistanceToGoal(player->currX, player->currY, scoringDirection) ? TRUE : FALSE;
+}
+
+int findPassTarget(PassIndex *index, int kicker, Player *player, int round) {
+    // Same choice as a scan of the whole team, the lowest index among the teammates that
+    // qualify, but only the cells around the kicker are visited
+    int column = player->currX / KICK_RANGE_MAX;
+    int row = player->currY / KICK_RANGE_MAX;
+    int target = DO_NOT_EXIST;
+    int r, c, p;
+    for (r = row - 1; r <= row + 1; r++) {
+        for (c = column - 1; c <= column + 1; c++) {
+            if (r < 0 || r >= index->rows || c < 0 || c >= index->columns) {
+                continue;
+            }
+            for (p = index->heads[(player->team * index->rows + r) * index->columns + c]; p != DO_NOT_EXIST;
+                p = index->next[p]) {
+                if (p != kicker && (target == DO_NOT_EXIST || p < target) &&
+                    isPassTarget(player, index->positions[p][0], index->positions[p][1], round)) {
+                    target = p;
+                }
+            }
+        }
+    }
+    return target;
+}
+
+/* ===================== KICKS =====================*/
+int kickIntoGoal(Player *player, Ball *ball, int round) {
+    // Count as goal when the goal is within kick range and reposition ball to center of field
+    int kickRange = player->kick * 2;
+    int goalX = getScoringDirection(player, round) == LEFT ? GOAL_LEFT_START_X - 1 : matchConfig.fieldLength;
+    if (bothPointsInRange(ball->x, ball->y, goalX, getGoalStartY(), kickRange) ||
+        bothPointsInRange(ball->x, ball->y, goalX, getGoalEndY(), kickRange)) {
+        ball->x = matchConfig.fieldLength / 2;
+        ball->y = matchConfig.fieldWidth / 2;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+int kickTowardsGoal(int index, Player *player, Ball *ball, int round, uint64_t seed) {
+    int kickRange = player->kick * 2;
+    int scoringDirection = getScoringDirection(player, round);
+    RngBlock draws = rngBlock(seed, round, index, RNG_KICK);
+    int horizontalDistance = rngBelow(draws.v[0], kickRange + 1);
+    int verticalDistance = kickRange - horizontalDistance;
+    ball->x = player->currX + (horizontalDistance * scoringDirection);
+    ball->y = player->currY + (verticalDistance * scoringDirection);
+
+    // Handle cases when ball is kicked out of field, reposition in center
+    if (ball->x < 0 || ball->x >= matchConfig.fieldLength || ball->y < 0 || ball->y >= matchConfig.fieldWidth) {
+        // printf("ball kicked out of field (%d, %d), repositioning to center\n", ball->x, ball->y);
+        ball->x = matchConfig.fieldLength / 2;
+        ball->y = matchConfig.fieldWidth / 2;
+        return KICK_OUT_OF_FIELD;
+    }
+    // printf("ball is now at (%d, %d)\n", ball->x, ball->y);
+    return KICK_TOWARDS_GOAL;
+}
+
+int playerKickBall(int index, Player *player, Ball *ball, int positions[][2], int round, uint64_t seed) {
+    // Determine new ball position with priorities:
+    // 1. Score into goal
+    // 2. Kick to teammate within kick range
+    // 3. Kick towards goal
+    if (player->kicked != PLAYER_KICKED_BALL) {
+        return KICK_NONE;
+    }
+    if (kickIntoGoal(player, ball, round)) {
+        return KICK_GOAL;
+    }
+
+    // Search for a teammate to pass to
+    int teamStartIndex = player->team == TEAM_A ? 0 : matchConfig.playersPerTeam;
+    int teamEndIndex = teamStartIndex + matchConfig.playersPerTeam - 1;
+    int p;
+    for (p = teamStartIndex; p <= teamEndIndex; p++) {
+        if (p != index && isPassTarget(player, positions[p][0], positions[p][1], round)) {
+            ball->x = positions[p][0];
+            ball->y = positions[p][1];
+            return KICK_PASS;
+        }
+    }
+    return kickTowardsGoal(index, player, ball, round, seed);
+}
+
+int playerKickBallIndexed(int index, Player *player, Ball *ball, PassIndex *passIndex, int round, uint64_t seed) {
+    // Same rules, the teammates come from the pass index
+    if (player->kicked != PLAYER_KICKED_BALL) {
+        return KICK_NONE;
+    }
+    if (kickIntoGoal(player, ball, round)) {
+        return KICK_GOAL;
+    }
+
+    int target = findPassTarget(passIndex, index, player, round);
+    if (target != DO_NOT_EXIST) {
+        ball->x = passIndex->positions[target][0];
+        ball->y = passIndex->positions[target][1];
+        return KICK_PASS;
+    }
+    return kickTowardsGoal(index, player, ball, round, seed);
+}
+
+void packPlayerRecord(Player *player, int *record) {
+    record[0] = player->prevX;
+    record[1] = player->prevY;
+    record[2] = player->currX;
+    record[3] = player->currY;
+    record[4] = player->team;
+    record[5] = player->reached;
+    record[6] = player->kicked;
+    record[7] = player->challenge;
+    record[8] = player->speed;
+    record[9] = player->dribble;
+    record[10] = player->kick;
+}
+
+uint64_t packPlayerWord(Player *player) {
+    // Four coordinates, then the reached and kicked flags and the challenge above them
+    uint64_t mask = WIRE_COORD_LIMIT - 1;
+    uint64_t word = ((uint64_t) (player->prevX + 1) & mask) |
+        ((uint64_t) (player->prevY + 1) & mask) << WIRE_COORD_BITS |
+        ((uint64_t) (player->currX + 1) & mask) << (2 * WIRE_COORD_BITS) |
+        ((uint64_t) (player->currY + 1) & mask) << (3 * WIRE_COORD_BITS);
+    word |= (uint64_t) (player->reached == PLAYER_REACHED_BALL) << (4 * WIRE_COORD_BITS);
+    word |= (uint64_t) (player->kicked == PLAYER_KICKED_BALL) << (4 * WIRE_COORD_BITS + 1);
+    word |= (uint64_t) (player->challenge + 1) << (4 * WIRE_COORD_BITS + 2);
+    return word;
+}
+
+uint32_t packPlayerStats(Player *player) {
+    return (uint32_t) player->speed | (uint32_t) player->dribble << WIRE_STAT_BITS |
+        (uint32_t) player->kick << (2 * WIRE_STAT_BITS) | (uint32_t) player->team << (3 * WIRE_STAT_BITS);
+}
+
+void unpackPlayerWord(uint64_t word, uint32_t stats, Player *player) {
+    uint64_t mask = WIRE_COORD_LIMIT - 1;
+    uint32_t statMask = (1 << WIRE_STAT_BITS) - 1;
+    player->prevX = (int) (word & mask) - 1;
+    player->prevY = (int) (word >> WIRE_COORD_BITS & mask) - 1;
+    player->currX = (int) (word >> (2 * WIRE_COORD_BITS) & mask) - 1;
+    player->currY = (int) (word >> (3 * WIRE_COORD_BITS) & mask) - 1;
+    player->reached = word >> (4 * WIRE_COORD_BITS) & 1 ? PLAYER_REACHED_BALL : PLAYER_NO_REACHED_BALL;
+    player->kicked = word >> (4 * WIRE_COORD_BITS + 1) & 1 ? PLAYER_KICKED_BALL : PLAYER_NO_KICKED_BALL;
+    player->challenge = (int) (word >> (4 * WIRE_COORD_BITS + 2)) - 1;
+    player->speed = stats & statMask;
+    player->dribble = stats >> WIRE_STAT_BITS & statMask;
+    player->kick = stats >> (2 * WIRE_STAT_BITS) & statMask;
+    player->team = stats >> (3 * WIRE_STAT_BITS);
+}
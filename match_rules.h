@@ -0,0 +1,149 @@
+#ifndef MATCH_RULES_H
+#define MATCH_RULES_H
+
+#include <stdint.h>
+
+#define TRUE 1
+#define FALSE 0
+#define DO_NOT_EXIST -1
+#define UP 1
+#define RIGHT 1
+#define DOWN -1
+#define LEFT -1
+
+#define FIELD_WIDTH 96
+#define FIELD_LENGTH 128
+#define SUBFIELD_WIDTH 32
+#define SUBFIELD_LENGTH 32
+
+#define GOAL_LEFT_START_X 0
+#define GOAL_LEFT_START_Y 43
+#define GOAL_LEFT_END_X 0
+#define GOAL_LEFT_END_Y 51
+#define GOAL_RIGHT_START_X 127
+#define GOAL_RIGHT_START_Y 43
+#define GOAL_RIGHT_END_X 127
+#define GOAL_RIGHT_END_Y 51
+
+#define ROUNDS 2700
+#define TEAMS 2
+#define FIELDS 12
+#define PLAYERS 22
+#define PLAYERS_PER_TEAM 11
+
+#define PLAYER_STAT_MAX 10
+#define PLAYER_ALL_MAX 15
+#define PLAYER_REACHED_BALL 1
+#define PLAYER_NO_REACHED_BALL 0
+#define PLAYER_KICKED_BALL 1
+#define PLAYER_NO_KICKED_BALL 0
+#define PLAYER_NO_CHALLENGE -1
+
+// The longest kick, every other stat at its minimum of 1
+#define KICK_RANGE_MAX (2 * (PLAYER_ALL_MAX - 2))
+
+// Compact wire format: the round state of a player packs into one 64-bit word, with every
+// coordinate shifted by one so DO_NOT_EXIST fits. Team and stats never change after
+// initPlayerState and pack into one 32-bit word
+#define WIRE_COORD_BITS 12
+#define WIRE_COORD_LIMIT (1 << WIRE_COORD_BITS)
+#define WIRE_STAT_BITS 8
+
+#define TEAM_A 0
+#define TEAM_B 1
+
+#define KICK_NONE 0
+#define KICK_GOAL 1
+#define KICK_PASS 2
+#define KICK_TOWARDS_GOAL 3
+#define KICK_OUT_OF_FIELD 4
+
+/* ==================== STRUCTS ====================*/
+// Runtime shape of a match, the constants above are its defaults. Subfields tile the
+// pitch from the origin, the last row and column may be cut short
+typedef struct {
+    int fieldLength, fieldWidth;
+    int subfieldLength, subfieldWidth;
+    int playersPerTeam, rounds;
+} MatchConfig;
+
+typedef struct {
+    int x, y;
+} Ball;
+
+typedef struct {
+    int prevX, prevY, currX, currY;
+    int team, reached, kicked, challenge;
+    int speed, dribble, kick;
+} Player;
+
+typedef struct {
+    // Where the claimer stands, which is where the ball is
+    int challenge, key, player;
+    int x, y;
+} KickClaim;
+
+// Uniform grid over the pitch with cells as wide as the longest kick, so every teammate a
+// kicker can reach stands in the 3x3 cells around it. Each team chains its players per
+// cell, and a player is only relinked when it changes cells
+typedef struct {
+    int columns, rows;
+    int *heads;
+    int *next;
+    int *cells;
+    int (*positions)[2];
+    int *members;
+    int count;
+} PassIndex;
+
+// Structure-of-arrays view of one player index across many independent matches,
+// lane m holds that player in match m
+typedef struct {
+    int *prevX, *prevY, *currX, *currY, *reached;
+    const int *speed, *ballX, *ballY;
+    const uint64_t *seeds;
+} MoveLanes;
+
+extern MatchConfig matchConfig;
+
+/* ===================== CONFIG =====================*/
+// Returns NULL when the configuration can be played, otherwise what is wrong with it
+const char *checkMatchConfig(MatchConfig *config);
+int getSubfieldColumns();
+int getSubfieldRows();
+int getFieldCount();
+int getPlayerCount();
+
+/* ===================== UTILS =====================*/
+int getFieldRankFromCoords(int x, int y);
+int getDistanceBetweenPoints(int x1, int y1, int x2, int y2);
+int bothPointsInRange(int x1, int y1, int x2, int y2, int distance);
+int getScoringDirection(Player *player, int round);
+int getMin(int value1, int value2);
+int kickClaimBeats(KickClaim *claim, KickClaim *other);
+int getDistanceToGoal(int x, int y, int scoringDirection);
+int goalScored(Ball *ball, Player *player, int round);
+
+/* =================== PASS INDEX ===================*/
+void initPassIndex(PassIndex *index);
+void freePassIndex(PassIndex *index);
+void clearPassIndex(PassIndex *index);
+void placeInPassIndex(PassIndex *index, int player, int x, int y);
+int findPassTarget(PassIndex *index, int kicker, Player *player, int round);
+
+/* ===================== RULES =====================*/
+// Every rule works on one player identified by its index 0..PLAYERS-1, the index and not
+// the process that runs it keys the random draws so every engine makes the same decisions
+void initPlayerState(int index, Player *player, uint64_t seed);
+void clearPlayerRound(Player *player);
+void movePlayerTowardsBall(int index, Ball *ball, Player *player, int round, uint64_t seed);
+void movePlayerLanes(MoveLanes *lanes, int count, int index, int round);
+void makeKickClaim(int index, Player *player, int round, uint64_t seed, KickClaim *claim);
+int playerKickBall(int index, Player *player, Ball *ball, int positions[][2], int round, uint64_t seed);
+int playerKickBallIndexed(int index, Player *player, Ball *ball, PassIndex *passIndex, int round, uint64_t seed);
+void packPlayerRecord(Player *player, int *record);
+uint64_t packPlayerWord(Player *player);
+uint32_t packPlayerStats(Player *player);
+void unpackPlayerWord(uint64_t word, uint32_t stats, Player *player);
+
+#endif
@@ -0,0 +1,253 @@
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "match_rules.h"
+#include "trace.h"
+
+// Single-node engine for the match: one shared state array stepped by a team of threads,
+// producing the same output as match_mpi for the same seed
+#define MAX_THREADS PLAYERS
+#define BARRIER_SPINS 1024
+
+/* ==================== STRUCTS ====================*/
+typedef struct {
+    atomic_int remaining;
+    atomic_int sense;
+    int threads;
+} Barrier;
+
+typedef struct {
+    int threads, timing, hasSeed;
+    uint64_t seed;
+    char *tracePath;
+} Options;
+
+typedef struct {
+    // Every thread reads all of the state but only writes the players it owns, the kick
+    // is resolved by the thread responsible for the subfield holding the ball
+    Player players[PLAYERS];
+    Ball ball;
+    KickClaim claims[MAX_THREADS];
+    Barrier barrier;
+    TraceWriter *trace;
+    uint64_t seed;
+    int threads;
+} Match;
+
+typedef struct {
+    Match *match;
+    int id;
+    pthread_t thread;
+} Worker;
+
+/* ===================== BARRIER =====================*/
+void barrierInit(Barrier *barrier, int threads) {
+    atomic_init(&barrier->remaining, threads);
+    atomic_init(&barrier->sense, 0);
+    barrier->threads = threads;
+}
+
+void barrierWait(Barrier *barrier, int *localSense) {
+    // Sense-reversing barrier: the last thread to arrive resets the count and flips the
+    // shared sense, which releases everyone spinning on it
+    *localSense = !*localSense;
+    if (atomic_fetch_sub(&barrier->remaining, 1) == 1) {
+        atomic_store(&barrier->remaining, barrier->threads);
+        atomic_store(&barrier->sense, *localSense);
+        return;
+    }
+
+    // Yield now and then so oversubscribed runs still make progress
+    int spins = 0;
+    while (atomic_load(&barrier->sense) != *localSense) {
+        if (++spins == BARRIER_SPINS) {
+            sched_yield();
+            spins = 0;
+        }
+    }
+}
+
+/* ===================== ROUND =====================*/
+void resolveKick(Match *match, int round) {
+    // Combine the best claim of every thread, same ordering as the MPI reduction
+    KickClaim winner = match->claims[0];
+    int t;
+    for (t = 1; t < match->threads; t++) {
+        if (kickClaimBeats(&match->claims[t], &winner)) {
+            winner = match->claims[t];
+        }
+    }
+
+    if (winner.challenge != PLAYER_NO_CHALLENGE) {
+        int positions[PLAYERS][2];
+        int p;
+        for (p = 0; p < PLAYERS; p++) {
+            positions[p][0] = match->players[p].currX;
+            positions[p][1] = match->players[p].currY;
+        }
+
+        Player *kicker = &match->players[winner.player];
+        kicker->kicked = PLAYER_KICKED_BALL;
+        playerKickBall(winner.player, kicker, &match->ball, positions, round, match->seed);
+    }
+}
+
+void recordRound(Match *match, int round) {
+    int32_t *record = traceNextRecord(match->trace);
+    record[0] = round;
+    record[1] = match->ball.x;
+    record[2] = match->ball.y;
+
+    int p;
+    for (p = 0; p < PLAYERS; p++) {
+        packPlayerRecord(&match->players[p], &record[TRACE_RECORD_HEADER_INTS + p * 11]);
+    }
+    traceCommitRecord(match->trace);
+}
+
+void *runWorker(void *argument) {
+    Worker *worker = (Worker *) argument;
+    Match *match = worker->match;
+    int threads = match->threads;
+
+    // Contiguous blocks of players keep threads off each other's cache lines
+    int firstPlayer = worker->id * PLAYERS / threads;
+    int lastPlayer = (worker->id + 1) * PLAYERS / threads;
+    int sense = 0;
+
+    int r, p;
+    for (r = 0; r < ROUNDS; r++) {
+        Ball ball = match->ball;
+
+        // Move the owned players and keep the best ball challenge among them
+        KickClaim best;
+        best.challenge = PLAYER_NO_CHALLENGE;
+        best.key = 0;
+        best.player = DO_NOT_EXIST;
+        for (p = firstPlayer; p < lastPlayer; p++) {
+            KickClaim claim;
+            clearPlayerRound(&match->players[p]);
+            movePlayerTowardsBall(p, &ball, &match->players[p], r, match->seed);
+            makeKickClaim(p, &match->players[p], r, match->seed, &claim);
+            if (kickClaimBeats(&claim, &best)) {
+                best = claim;
+            }
+        }
+        match->claims[worker->id] = best;
+
+        // Wait for all player movement to finish
+        barrierWait(&match->barrier, &sense);
+
+        if (getFieldRankFromCoords(ball.x, ball.y) % threads == worker->id) {
+            resolveKick(match, r);
+            recordRound(match, r);
+        }
+
+        // Ensure the kick is applied before proceeding to next round
+        barrierWait(&match->barrier, &sense);
+    }
+
+    return NULL;
+}
+
+/* =============== OPTIONS AND TIMING ===============*/
+void parseOptions(int argc, char *argv[], Options *options) {
+    options->threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    options->timing = FALSE;
+    options->hasSeed = FALSE;
+    options->tracePath = NULL;
+
+    int i;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options->threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--timing") == 0) {
+            options->timing = TRUE;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options->hasSeed = TRUE;
+            options->seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options->tracePath = argv[++i];
+        } else {
+            fprintf(stderr, "Unknown option %s\nUsage: %s [--threads N] [--timing] [--seed N] [--trace FILE]\n", argv[i], argv[0]);
+            exit(1);
+        }
+    }
+
+    if (options->threads < 1) {
+        options->threads = 1;
+    }
+    if (options->threads > MAX_THREADS) {
+        options->threads = MAX_THREADS;
+    }
+}
+
+double getWallTime() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/* ======================== MAIN =========================*/
+int main(int argc, char *argv[]) {
+    Options options;
+    parseOptions(argc, argv, &options);
+
+    static Match match;
+    match.threads = options.threads;
+    match.seed = options.hasSeed ? options.seed : (uint64_t) time(0);
+    if (!options.hasSeed) {
+        fprintf(stderr, "seed=%" PRIu64 "\n", match.seed);
+    }
+
+    match.trace = traceOpen(options.tracePath, TRACE_MATCH, PLAYERS, 11);
+    if (match.trace == NULL) {
+        fprintf(stderr, "Cannot open trace file %s\n", options.tracePath);
+        return 1;
+    }
+
+    // Initialize ball position in the center and all players randomly
+    match.ball.x = FIELD_LENGTH / 2;
+    match.ball.y = FIELD_WIDTH / 2;
+    int p;
+    for (p = 0; p < PLAYERS; p++) {
+        initPlayerState(p, &match.players[p], match.seed);
+    }
+    barrierInit(&match.barrier, match.threads);
+
+    // The main thread runs as worker 0
+    Worker workers[MAX_THREADS];
+    double start = getWallTime();
+    int t;
+    for (t = 0; t < match.threads; t++) {
+        workers[t].match = &match;
+        workers[t].id = t;
+        if (t > 0) {
+            pthread_create(&workers[t].thread, NULL, runWorker, &workers[t]);
+        }
+    }
+    runWorker(&workers[0]);
+    for (t = 1; t < match.threads; t++) {
+        pthread_join(workers[t].thread, NULL);
+    }
+    double elapsed = getWallTime() - start;
+
+    if (options.timing) {
+        fprintf(stderr, "threads=%d rounds=%d total=%.3fs rounds/s=%.0f\n",
+            match.threads, ROUNDS, elapsed, ROUNDS / elapsed);
+    }
+
+    if (traceClose(match.trace) != 0) {
+        fprintf(stderr, "Failed to write round output\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,258 @@
+#include <string.h>
+
+#include "move_simd.h"
+#include "rng.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MOVE_SIMD_X86 1
+#endif
+
+/* ===================== UTILS =====================*/
+static void moveRemainingLanes(MoveLanes *lanes, int start, int count, int index, int round) {
+    if (start >= count) {
+        return;
+    }
+
+    MoveLanes tail;
+    tail.prevX = lanes->prevX + start;
+    tail.prevY = lanes->prevY + start;
+    tail.currX = lanes->currX + start;
+    tail.currY = lanes->currY + start;
+    tail.reached = lanes->reached + start;
+    tail.speed = lanes->speed + start;
+    tail.ballX = lanes->ballX + start;
+    tail.ballY = lanes->ballY + start;
+    tail.seeds = lanes->seeds + start;
+    movePlayerLanes(&tail, count - start, index, round);
+}
+
+#ifdef MOVE_SIMD_X86
+/* ====================== AVX2 ======================*/
+// 32x32 -> 64 bit products of all eight lanes, split into high and low halves
+__attribute__((target("avx2")))
+static inline void mulHiLoAVX2(__m256i a, __m256i b, __m256i *hi, __m256i *lo) {
+    __m256i even = _mm256_mul_epu32(a, b);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+    *lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+    *hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+}
+
+// First output word of Philox4x32-10 for eight keys and one shared counter
+__attribute__((target("avx2")))
+static inline __m256i philoxAVX2(__m256i k0, __m256i k1, uint32_t round, uint32_t index, uint32_t purpose) {
+    __m256i c0 = _mm256_set1_epi32((int) round);
+    __m256i c1 = _mm256_set1_epi32((int) index);
+    __m256i c2 = _mm256_set1_epi32((int) purpose);
+    __m256i c3 = _mm256_setzero_si256();
+    __m256i m0 = _mm256_set1_epi32((int) PHILOX_M0);
+    __m256i m1 = _mm256_set1_epi32((int) PHILOX_M1);
+    __m256i w0 = _mm256_set1_epi32((int) PHILOX_W0);
+    __m256i w1 = _mm256_set1_epi32((int) PHILOX_W1);
+
+    int i;
+    for (i = 0; i < PHILOX_ROUNDS; i++) {
+        __m256i hi0, lo0, hi1, lo1;
+        mulHiLoAVX2(c0, m0, &hi0, &lo0);
+        mulHiLoAVX2(c2, m1, &hi1, &lo1);
+        c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), k0);
+        c1 = lo1;
+        c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), k1);
+        c3 = lo0;
+        k0 = _mm256_add_epi32(k0, w0);
+        k1 = _mm256_add_epi32(k1, w1);
+    }
+    return c0;
+}
+
+__attribute__((target("avx2")))
+void movePlayerLanesAVX2(MoveLanes *lanes, int count, int index, int round) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i maxX = _mm256_set1_epi32(matchConfig.fieldLength - 1);
+    const __m256i maxY = _mm256_set1_epi32(matchConfig.fieldWidth - 1);
+    const __m256i reachedBall = _mm256_set1_epi32(PLAYER_REACHED_BALL);
+    const __m256i splitSeeds = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+    int m;
+    for (m = 0; m + 8 <= count; m += 8) {
+        __m256i ballX = _mm256_loadu_si256((const __m256i *) &lanes->ballX[m]);
+        __m256i ballY = _mm256_loadu_si256((const __m256i *) &lanes->ballY[m]);
+        __m256i currX = _mm256_loadu_si256((const __m256i *) &lanes->currX[m]);
+        __m256i currY = _mm256_loadu_si256((const __m256i *) &lanes->currY[m]);
+        __m256i speed = _mm256_loadu_si256((const __m256i *) &lanes->speed[m]);
+        __m256i reached = _mm256_loadu_si256((const __m256i *) &lanes->reached[m]);
+
+        // Split eight 64-bit seeds into the two 32-bit Philox key words
+        __m256i seedsLow = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *) &lanes->seeds[m]), splitSeeds);
+        __m256i seedsHigh = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *) &lanes->seeds[m + 4]), splitSeeds);
+        __m256i k0 = _mm256_permute2x128_si256(seedsLow, seedsHigh, 0x20);
+        __m256i k1 = _mm256_permute2x128_si256(seedsLow, seedsHigh, 0x31);
+
+        // Ball within speed squares: move onto the ball
+        __m256i dx = _mm256_sub_epi32(ballX, currX);
+        __m256i dy = _mm256_sub_epi32(ballY, currY);
+        __m256i distance = _mm256_add_epi32(_mm256_abs_epi32(dx), _mm256_abs_epi32(dy));
+        __m256i bound = _mm256_add_epi32(speed, one);
+        __m256i inRange = _mm256_cmpgt_epi32(bound, distance);
+
+        // Otherwise split speed randomly between both directions towards the ball
+        __m256i draw = philoxAVX2(k0, k1, (uint32_t) round, (uint32_t) index, RNG_MOVE);
+        __m256i horizontalDistance, unused;
+        mulHiLoAVX2(draw, bound, &horizontalDistance, &unused);
+        __m256i verticalDistance = _mm256_sub_epi32(speed, horizontalDistance);
+        __m256i stepX = _mm256_blendv_epi8(_mm256_sub_epi32(zero, horizontalDistance), horizontalDistance, _mm256_cmpgt_epi32(dx, zero));
+        __m256i stepY = _mm256_blendv_epi8(_mm256_sub_epi32(zero, verticalDistance), verticalDistance, _mm256_cmpgt_epi32(dy, zero));
+        __m256i movedX = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(currX, stepX), zero), maxX);
+        __m256i movedY = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(currY, stepY), zero), maxY);
+
+        _mm256_storeu_si256((__m256i *) &lanes->prevX[m], currX);
+        _mm256_storeu_si256((__m256i *) &lanes->prevY[m], currY);
+        _mm256_storeu_si256((__m256i *) &lanes->currX[m], _mm256_blendv_epi8(movedX, ballX, inRange));
+        _mm256_storeu_si256((__m256i *) &lanes->currY[m], _mm256_blendv_epi8(movedY, ballY, inRange));
+        _mm256_storeu_si256((__m256i *) &lanes->reached[m], _mm256_blendv_epi8(reached, reachedBall, inRange));
+    }
+
+    moveRemainingLanes(lanes, m, count, index, round);
+}
+
+/* ====================== SSE ======================*/
+__attribute__((target("sse4.1")))
+static inline void mulHiLoSSE(__m128i a, __m128i b, __m128i *hi, __m128i *lo) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    *lo = _mm_blend_epi16(even, _mm_slli_epi64(odd, 32), 0xCC);
+    *hi = _mm_blend_epi16(_mm_srli_epi64(even, 32), odd, 0xCC);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i philoxSSE(__m128i k0, __m128i k1, uint32_t round, uint32_t index, uint32_t purpose) {
+    __m128i c0 = _mm_set1_epi32((int) round);
+    __m128i c1 = _mm_set1_epi32((int) index);
+    __m128i c2 = _mm_set1_epi32((int) purpose);
+    __m128i c3 = _mm_setzero_si128();
+    __m128i m0 = _mm_set1_epi32((int) PHILOX_M0);
+    __m128i m1 = _mm_set1_epi32((int) PHILOX_M1);
+    __m128i w0 = _mm_set1_epi32((int) PHILOX_W0);
+    __m128i w1 = _mm_set1_epi32((int) PHILOX_W1);
+
+    int i;
+    for (i = 0; i < PHILOX_ROUNDS; i++) {
+        __m128i hi0, lo0, hi1, lo1;
+        mulHiLoSSE(c0, m0, &hi0, &lo0);
+        mulHiLoSSE(c2, m1, &hi1, &lo1);
+        c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), k0);
+        c1 = lo1;
+        c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), k1);
+        c3 = lo0;
+        k0 = _mm_add_epi32(k0, w0);
+        k1 = _mm_add_epi32(k1, w1);
+    }
+    return c0;
+}
+
+__attribute__((target("sse4.1")))
+void movePlayerLanesSSE(MoveLanes *lanes, int count, int index, int round) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i maxX = _mm_set1_epi32(matchConfig.fieldLength - 1);
+    const __m128i maxY = _mm_set1_epi32(matchConfig.fieldWidth - 1);
+    const __m128i reachedBall = _mm_set1_epi32(PLAYER_REACHED_BALL);
+
+    int m;
+    for (m = 0; m + 4 <= count; m += 4) {
+        __m128i ballX = _mm_loadu_si128((const __m128i *) &lanes->ballX[m]);
+        __m128i ballY = _mm_loadu_si128((const __m128i *) &lanes->ballY[m]);
+        __m128i currX = _mm_loadu_si128((const __m128i *) &lanes->currX[m]);
+        __m128i currY = _mm_loadu_si128((const __m128i *) &lanes->currY[m]);
+        __m128i speed = _mm_loadu_si128((const __m128i *) &lanes->speed[m]);
+        __m128i reached = _mm_loadu_si128((const __m128i *) &lanes->reached[m]);
+
+        // Split four 64-bit seeds into the two 32-bit Philox key words
+        __m128 seedsLow = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *) &lanes->seeds[m]));
+        __m128 seedsHigh = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *) &lanes->seeds[m + 2]));
+        __m128i k0 = _mm_castps_si128(_mm_shuffle_ps(seedsLow, seedsHigh, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i k1 = _mm_castps_si128(_mm_shuffle_ps(seedsLow, seedsHigh, _MM_SHUFFLE(3, 1, 3, 1)));
+
+        // Ball within speed squares: move onto the ball
+        __m128i dx = _mm_sub_epi32(ballX, currX);
+        __m128i dy = _mm_sub_epi32(ballY, currY);
+        __m128i distance = _mm_add_epi32(_mm_abs_epi32(dx), _mm_abs_epi32(dy));
+        __m128i bound = _mm_add_epi32(speed, one);
+        __m128i inRange = _mm_cmpgt_epi32(bound, distance);
+
+        // Otherwise split speed randomly between both directions towards the ball
+        __m128i draw = philoxSSE(k0, k1, (uint32_t) round, (uint32_t) index, RNG_MOVE);
+        __m128i horizontalDistance, unused;
+        mulHiLoSSE(draw, bound, &horizontalDistance, &unused);
+        __m128i verticalDistance = _mm_sub_epi32(speed, horizontalDistance);
+        __m128i stepX = _mm_blendv_epi8(_mm_sub_epi32(zero, horizontalDistance), horizontalDistance, _mm_cmpgt_epi32(dx, zero));
+        __m128i stepY = _mm_blendv_epi8(_mm_sub_epi32(zero, verticalDistance), verticalDistance, _mm_cmpgt_epi32(dy, zero));
+        __m128i movedX = _mm_min_epi32(_mm_max_epi32(_mm_add_epi32(currX, stepX), zero), maxX);
+        __m128i movedY = _mm_min_epi32(_mm_max_epi32(_mm_add_epi32(currY, stepY), zero), maxY);
+
+        _mm_storeu_si128((__m128i *) &lanes->prevX[m], currX);
+        _mm_storeu_si128((__m128i *) &lanes->prevY[m], currY);
+        _mm_storeu_si128((__m128i *) &lanes->currX[m], _mm_blendv_epi8(movedX, ballX, inRange));
+        _mm_storeu_si128((__m128i *) &lanes->currY[m], _mm_blendv_epi8(movedY, ballY, inRange));
+        _mm_storeu_si128((__m128i *) &lanes->reached[m], _mm_blendv_epi8(reached, reachedBall, inRange));
+    }
+
+    moveRemainingLanes(lanes, m, count, index, round);
+}
+#else
+void movePlayerLanesAVX2(MoveLanes *lanes, int count, int index, int round) {
+    movePlayerLanes(lanes, count, index, round);
+}
+
+void movePlayerLanesSSE(MoveLanes *lanes, int count, int index, int round) {
+    movePlayerLanes(lanes, count, index, round);
+}
+#endif
+
+/* ==================== DISPATCH ====================*/
+int resolveMoveKernel(int kernel) {
+    int best = MOVE_KERNEL_SCALAR;
+#ifdef MOVE_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        best = MOVE_KERNEL_AVX2;
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        best = MOVE_KERNEL_SSE;
+    }
+#endif
+    return kernel == MOVE_KERNEL_AUTO || kernel > best ? best : kernel;
+}
+
+MoveKernel getMoveKernel(int kernel) {
+    if (kernel == MOVE_KERNEL_AVX2) {
+        return movePlayerLanesAVX2;
+    }
+    if (kernel == MOVE_KERNEL_SSE) {
+        return movePlayerLanesSSE;
+    }
+    return movePlayerLanes;
+}
+
+const char *getMoveKernelName(int kernel) {
+    if (kernel == MOVE_KERNEL_AVX2) {
+        return "avx2";
+    }
+    if (kernel == MOVE_KERNEL_SSE) {
+        return "sse";
+    }
+    if (kernel == MOVE_KERNEL_AUTO) {
+        return "auto";
+    }
+    return "scalar";
+}
+
+int parseMoveKernel(const char *name) {
+    int kernel;
+    for (kernel = MOVE_KERNEL_SCALAR; kernel <= MOVE_KERNEL_AUTO; kernel++) {
+        if (strcmp(name, getMoveKernelName(kernel)) == 0) {
+            return kernel;
+        }
+    }
+    return DO_NOT_EXIST;
+}
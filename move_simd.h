@@ -0,0 +1,26 @@
+#ifndef MOVE_SIMD_H
+#define MOVE_SIMD_H
+
+#include "match_rules.h"
+
+// Vectorized versions of movePlayerLanes. They draw the same Philox numbers and give
+// bit-identical results, lanes left over after the last full vector use the scalar rule
+#define MOVE_KERNEL_SCALAR 0
+#define MOVE_KERNEL_SSE 1
+#define MOVE_KERNEL_AVX2 2
+#define MOVE_KERNEL_AUTO 3
+
+typedef void (*MoveKernel)(MoveLanes *lanes, int count, int index, int round);
+
+void movePlayerLanesSSE(MoveLanes *lanes, int count, int index, int round);
+void movePlayerLanesAVX2(MoveLanes *lanes, int count, int index, int round);
+
+// Maps MOVE_KERNEL_AUTO, or a kernel this CPU cannot run, to the widest supported kernel
+int resolveMoveKernel(int kernel);
+MoveKernel getMoveKernel(int kernel);
+const char *getMoveKernelName(int kernel);
+
+// Returns DO_NOT_EXIST for an unknown name
+int parseMoveKernel(const char *name);
+
+#endif
@@ -0,0 +1,203 @@
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+
+/* ===================== UTILS =====================*/
+int profileBin(double seconds) {
+    uint64_t ns = seconds > 0 ? (uint64_t) (seconds * 1e9) : 0;
+    if (ns < 4) {
+        return (int) ns;
+    }
+
+    // Octave from the leading bit, then the next two bits split it in four
+    int octave = 63 - __builtin_clzll(ns);
+    int bin = (octave - 1) * 4 + (int) ((ns >> (octave - 2)) & 3);
+    return bin < PROFILE_BINS ? bin : PROFILE_BINS - 1;
+}
+
+double profileBinStart(int bin) {
+    if (bin < 4) {
+        return bin * 1e-9;
+    }
+    int octave = bin / 4 + 1;
+    return (double) ((uint64_t) (4 + bin % 4) << (octave - 2)) * 1e-9;
+}
+
+double profileBinSeconds(int bin) {
+    // Midpoint of the bin
+    return (profileBinStart(bin) + profileBinStart(bin + 1)) / 2;
+}
+
+void clearStats(ProfileStats *stats) {
+    memset(stats, 0, sizeof(ProfileStats));
+    stats->min = DBL_MAX;
+}
+
+void addSample(ProfileStats *stats, double elapsed) {
+    stats->count++;
+    stats->total += elapsed;
+    if (elapsed < stats->min) {
+        stats->min = elapsed;
+    }
+    if (elapsed > stats->max) {
+        stats->max = elapsed;
+    }
+    stats->bins[profileBin(elapsed)]++;
+}
+
+double statsPercentile(ProfileStats *stats, double fraction) {
+    // Bin midpoint of the sample at that rank, kept within the exact extremes
+    uint64_t target = (uint64_t) (fraction * (stats->count - 1)) + 1;
+    uint64_t seen = 0;
+    int b;
+    for (b = 0; b < PROFILE_BINS; b++) {
+        seen += stats->bins[b];
+        if (seen >= target) {
+            double value = profileBinSeconds(b);
+            return value < stats->min ? stats->min : value > stats->max ? stats->max : value;
+        }
+    }
+    return stats->max;
+}
+
+int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+void reduceStats(ProfileStats *stats, ProfileStats *merged, int root, MPI_Comm comm) {
+    MPI_Reduce(&stats->count, &merged->count, 1, MPI_UINT64_T, MPI_SUM, root, comm);
+    MPI_Reduce(&stats->total, &merged->total, 1, MPI_DOUBLE, MPI_SUM, root, comm);
+    MPI_Reduce(&stats->min, &merged->min, 1, MPI_DOUBLE, MPI_MIN, root, comm);
+    MPI_Reduce(&stats->max, &merged->max, 1, MPI_DOUBLE, MPI_MAX, root, comm);
+    MPI_Reduce(stats->bins, merged->bins, PROFILE_BINS, MPI_UINT64_T, MPI_SUM, root, comm);
+}
+
+void printHistogram(const char *label, ProfileStats *stats) {
+    // One count per power of two labelled with its start, from the fastest to the slowest
+    // occupied one
+    uint64_t octaves[PROFILE_BINS / 4];
+    int first = PROFILE_BINS / 4, last = -1;
+    int b;
+    memset(octaves, 0, sizeof(octaves));
+    for (b = 0; b < PROFILE_BINS; b++) {
+        octaves[b / 4] += stats->bins[b];
+        if (stats->bins[b] > 0) {
+            first = b / 4 < first ? b / 4 : first;
+            last = b / 4;
+        }
+    }
+
+    fprintf(stderr, "  %-7s total=%.3fs p50=%.1fus p99=%.1fus |", label, stats->total,
+        stats->count > 0 ? statsPercentile(stats, 0.5) * 1e6 : 0.0,
+        stats->count > 0 ? statsPercentile(stats, 0.99) * 1e6 : 0.0);
+    for (b = first; b <= last; b++) {
+        fprintf(stderr, " %.3gus:%llu", profileBinStart(b * 4) * 1e6, (unsigned long long) octaves[b]);
+    }
+    fprintf(stderr, "\n");
+}
+
+/* ===================== API =====================*/
+void profileInit(Profile *profile, int flag, const ProfilePhase *phases, int count, MPI_Comm comm) {
+    const char *env = getenv(PROFILE_ENV);
+    int enabled = flag || (env != NULL && env[0] != '\0' && strcmp(env, "0") != 0);
+    MPI_Allreduce(&enabled, &profile->enabled, 1, MPI_INT, MPI_MAX, comm);
+
+    profile->phases = count < PROFILE_MAX_PHASES ? count : PROFILE_MAX_PHASES;
+    profile->phase = phases;
+    profile->last = MPI_Wtime();
+
+    int p, k;
+    for (p = 0; p < profile->phases; p++) {
+        clearStats(&profile->phaseStats[p]);
+    }
+    for (k = 0; k < PROFILE_KINDS; k++) {
+        profile->round[k] = 0;
+        clearStats(&profile->roundStats[k]);
+    }
+}
+
+void profileRecord(Profile *profile, int phase, double elapsed) {
+    addSample(&profile->phaseStats[phase], elapsed);
+    profile->round[profile->phase[phase].kind] += elapsed;
+}
+
+void profileEndRound(Profile *profile) {
+    if (!profile->enabled) {
+        return;
+    }
+
+    int k;
+    for (k = 0; k < PROFILE_KINDS; k++) {
+        addSample(&profile->roundStats[k], profile->round[k]);
+        profile->round[k] = 0;
+    }
+}
+
+void profileReport(Profile *profile, int rank, int root, MPI_Comm comm) {
+    if (!profile->enabled) {
+        return;
+    }
+
+    int size;
+    MPI_Comm_size(comm, &size);
+
+    // Every phase call on every process, merged into one distribution per phase
+    if (rank == root) {
+        fprintf(stderr, "profile phases (per call, all processes)\n");
+        fprintf(stderr, "  %-22s %-7s %9s %10s %10s %10s %10s %10s\n",
+            "phase", "kind", "calls", "total(s)", "min(us)", "p50(us)", "p99(us)", "max(us)");
+    }
+    int p;
+    for (p = 0; p < profile->phases; p++) {
+        ProfileStats merged;
+        reduceStats(&profile->phaseStats[p], &merged, root, comm);
+        if (rank == root && merged.count > 0) {
+            fprintf(stderr, "  %-22s %-7s %9llu %10.3f %10.1f %10.1f %10.1f %10.1f\n",
+                profile->phase[p].name, profile->phase[p].kind == PROFILE_COMPUTE ? "compute" : "wait",
+                (unsigned long long) merged.count, merged.total, merged.min * 1e6,
+                statsPercentile(&merged, 0.5) * 1e6, statsPercentile(&merged, 0.99) * 1e6, merged.max * 1e6);
+        }
+    }
+
+    // Per process compute and wait time of every round
+    ProfileStats *all = NULL;
+    if (rank == root) {
+        all = malloc(size * PROFILE_KINDS * sizeof(ProfileStats));
+    }
+    MPI_Gather(profile->roundStats, PROFILE_KINDS * sizeof(ProfileStats), MPI_BYTE,
+        all, PROFILE_KINDS * sizeof(ProfileStats), MPI_BYTE, root, comm);
+    if (rank != root) {
+        return;
+    }
+
+    const char *labels[PROFILE_KINDS] = {"compute", "wait"};
+    int r, k;
+    fprintf(stderr, "profile rounds per process (round time histograms)\n");
+    for (r = 0; r < size; r++) {
+        fprintf(stderr, "  rank %d\n", r);
+        for (k = 0; k < PROFILE_KINDS; k++) {
+            printHistogram(labels[k], &all[r * PROFILE_KINDS + k]);
+        }
+    }
+
+    // Spread of the per process totals
+    double *totals = malloc(size * sizeof(double));
+    fprintf(stderr, "profile totals across processes\n");
+    fprintf(stderr, "  %-7s %10s %10s %10s %10s\n", "kind", "min(s)", "p50(s)", "p99(s)", "max(s)");
+    for (k = 0; k < PROFILE_KINDS; k++) {
+        for (r = 0; r < size; r++) {
+            totals[r] = all[r * PROFILE_KINDS + k].total;
+        }
+        qsort(totals, size, sizeof(double), compareDoubles);
+        fprintf(stderr, "  %-7s %10.3f %10.3f %10.3f %10.3f\n", labels[k],
+            totals[0], totals[(size - 1) / 2], totals[(int) (0.99 * (size - 1))], totals[size - 1]);
+    }
+
+    free(totals);
+    free(all);
+}
@@ -0,0 +1,67 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <mpi.h>
+#include <stdint.h>
+
+// Per-phase round profiler. Every phase is either compute (local work) or wait (time spent
+// inside MPI calls and barriers). Marks are chained, so each costs one MPI_Wtime call,
+// and when profiling is disabled a mark is a single untaken branch
+#define PROFILE_ENV "FB_PROFILE"
+#define PROFILE_MAX_PHASES 24
+#define PROFILE_NO_PHASE -1
+
+#define PROFILE_COMPUTE 0
+#define PROFILE_WAIT 1
+#define PROFILE_KINDS 2
+
+// Log-scale nanosecond bins, four per power of two
+#define PROFILE_BINS 160
+
+/* ==================== STRUCTS ====================*/
+typedef struct {
+    const char *name;
+    int kind;
+} ProfilePhase;
+
+typedef struct {
+    uint64_t count;
+    double total, min, max;
+    uint64_t bins[PROFILE_BINS];
+} ProfileStats;
+
+typedef struct {
+    int enabled, phases;
+    const ProfilePhase *phase;
+    double last;
+
+    // Time of each kind spent in the current round, binned once the round ends
+    double round[PROFILE_KINDS];
+    ProfileStats phaseStats[PROFILE_MAX_PHASES];
+    ProfileStats roundStats[PROFILE_KINDS];
+} Profile;
+
+/* ===================== API =====================*/
+// Collective over comm, profiling is on everywhere if the flag or FB_PROFILE is set on
+// any process
+void profileInit(Profile *profile, int flag, const ProfilePhase *phases, int count, MPI_Comm comm);
+void profileRecord(Profile *profile, int phase, double elapsed);
+void profileEndRound(Profile *profile);
+
+// Collective over comm, prints the report on root before MPI_Finalize
+void profileReport(Profile *profile, int rank, int root, MPI_Comm comm);
+
+// Charges the time since the previous mark to phase, PROFILE_NO_PHASE drops it
+static inline void profileMark(Profile *profile, int phase) {
+    if (!profile->enabled) {
+        return;
+    }
+
+    double now = MPI_Wtime();
+    if (phase != PROFILE_NO_PHASE) {
+        profileRecord(profile, phase, now - profile->last);
+    }
+    profile->last = now;
+}
+
+#endif
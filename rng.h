@@ -0,0 +1,62 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// Counter-based random numbers (Philox4x32-10). Every draw is a pure function of the
+// run seed and a counter built from (round, player, purpose), so results do not depend
+// on which process or thread makes the draw or in which order draws happen.
+#define RNG_NO_ROUND 0xFFFFFFFFu
+#define RNG_NO_PLAYER 0xFFFFFFFFu
+
+// Purposes, one per random decision in the simulations
+#define RNG_INIT_PLAYER 0
+#define RNG_MOVE 1
+#define RNG_CHALLENGE 2
+#define RNG_TIE_BREAK 3
+#define RNG_KICK 4
+#define RNG_KICK_SELECTION 5
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+typedef struct {
+    uint32_t v[4];
+} RngBlock;
+
+static inline RngBlock rngPhilox(uint32_t counter[4], uint32_t key[2]) {
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+
+    int i;
+    for (i = 0; i < PHILOX_ROUNDS; i++) {
+        uint64_t product0 = (uint64_t) PHILOX_M0 * c0;
+        uint64_t product1 = (uint64_t) PHILOX_M1 * c2;
+        c0 = (uint32_t) (product1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t) product1;
+        c2 = (uint32_t) (product0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t) product0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    RngBlock block = {{c0, c1, c2, c3}};
+    return block;
+}
+
+// Four independent 32-bit words for one (round, player, purpose) decision
+static inline RngBlock rngBlock(uint64_t seed, uint32_t round, uint32_t player, uint32_t purpose) {
+    uint32_t counter[4] = {round, player, purpose, 0};
+    uint32_t key[2] = {(uint32_t) seed, (uint32_t) (seed >> 32)};
+    return rngPhilox(counter, key);
+}
+
+// Maps a random word onto [0, bound) by multiplication, bound must be positive
+static inline int rngBelow(uint32_t word, int bound) {
+    return (int) (((uint64_t) word * (uint32_t) bound) >> 32);
+}
+
+#endif
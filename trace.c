@@ -0,0 +1,225 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+/* ==================== STRUCTS ====================*/
+// Two buffers form the ring: the simulation fills the active one while the writer
+// thread drains the other, so the simulation only waits when both are full
+struct TraceWriter {
+    FILE *file;
+    int binary;
+    TraceHeader header;
+    int recordInts;
+
+    int32_t *buffers[2];
+    int counts[2];
+    int full[2];
+    int active;
+    int closing;
+
+    uint64_t *index;
+    uint32_t indexCount, indexCapacity;
+    uint64_t offset;
+    int error;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+};
+
+/* ===================== FORMAT =====================*/
+int traceRecordInts(TraceHeader *header) {
+    return TRACE_RECORD_HEADER_INTS + header->rows * header->columns;
+}
+
+int traceReadHeader(FILE *file, TraceHeader *header) {
+    if (fread(header, sizeof(TraceHeader), 1, file) != 1) {
+        return -1;
+    }
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || header->version != TRACE_VERSION) {
+        return -1;
+    }
+    return 0;
+}
+
+void traceFormatRecord(FILE *file, TraceHeader *header, const int32_t *record) {
+    // Reproduces the text output of the simulation programs exactly
+    fprintf(file, "%d\n", record[0]);
+    fprintf(file, "%d %d\n", record[1], record[2]);
+
+    const int32_t *row = &record[TRACE_RECORD_HEADER_INTS];
+    int r, c;
+    for (r = 0; r < header->rows; r++) {
+        if (header->kind == TRACE_TRAINING) {
+            for (c = 0; c < header->columns; c++) {
+                fprintf(file, c == 0 ? "%d" : " %d", row[c]);
+            }
+        } else {
+            for (c = 0; c < header->columns; c++) {
+                fprintf(file, "%d ", row[c]);
+            }
+        }
+        fprintf(file, "\n");
+        row += header->columns;
+    }
+    fprintf(file, "\n");
+}
+
+/* ===================== WRITER =====================*/
+void traceDrainBuffer(TraceWriter *writer, int b) {
+    int32_t *record = writer->buffers[b];
+    int count = writer->counts[b];
+
+    if (!writer->binary) {
+        int i;
+        for (i = 0; i < count; i++) {
+            traceFormatRecord(writer->file, &writer->header, record);
+            record += writer->recordInts;
+        }
+        return;
+    }
+
+    // Remember where every record starts for the index
+    if (writer->indexCount + count > writer->indexCapacity) {
+        writer->indexCapacity = (writer->indexCount + count) * 2;
+        writer->index = realloc(writer->index, writer->indexCapacity * sizeof(uint64_t));
+    }
+    int i;
+    for (i = 0; i < count; i++) {
+        writer->index[writer->indexCount++] = writer->offset;
+        writer->offset += writer->recordInts * sizeof(int32_t);
+    }
+
+    if (fwrite(record, writer->recordInts * sizeof(int32_t), count, writer->file) != (size_t) count) {
+        writer->error = 1;
+    }
+}
+
+void *traceWriterThread(void *argument) {
+    TraceWriter *writer = (TraceWriter *) argument;
+
+    // Buffers are filled in alternating order, so draining in the same order keeps rounds sorted
+    int b = 0;
+    pthread_mutex_lock(&writer->lock);
+    while (1) {
+        while (!writer->full[b] && !writer->closing) {
+            pthread_cond_wait(&writer->changed, &writer->lock);
+        }
+        if (!writer->full[b]) {
+            break;
+        }
+        pthread_mutex_unlock(&writer->lock);
+
+        traceDrainBuffer(writer, b);
+
+        pthread_mutex_lock(&writer->lock);
+        writer->counts[b] = 0;
+        writer->full[b] = 0;
+        pthread_cond_broadcast(&writer->changed);
+        b = 1 - b;
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    return NULL;
+}
+
+TraceWriter *traceOpen(const char *path, int kind, int rows, int columns) {
+    TraceWriter *writer = calloc(1, sizeof(TraceWriter));
+
+    memcpy(writer->header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    writer->header.version = TRACE_VERSION;
+    writer->header.kind = kind;
+    writer->header.rows = rows;
+    writer->header.columns = columns;
+    writer->recordInts = traceRecordInts(&writer->header);
+
+    if (path == NULL) {
+        writer->file = stdout;
+    } else {
+        writer->file = fopen(path, "wb");
+        if (writer->file == NULL) {
+            free(writer);
+            return NULL;
+        }
+        writer->binary = 1;
+        if (fwrite(&writer->header, sizeof(TraceHeader), 1, writer->file) != 1) {
+            writer->error = 1;
+        }
+        writer->offset = sizeof(TraceHeader);
+    }
+
+    int b;
+    for (b = 0; b < 2; b++) {
+        writer->buffers[b] = malloc(TRACE_BUFFER_RECORDS * writer->recordInts * sizeof(int32_t));
+    }
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->changed, NULL);
+    pthread_create(&writer->thread, NULL, traceWriterThread, writer);
+
+    return writer;
+}
+
+int32_t *traceNextRecord(TraceWriter *writer) {
+    // The active buffer always has room, a full one is handed off on commit
+    int active = writer->active;
+    return &writer->buffers[active][writer->counts[active] * writer->recordInts];
+}
+
+void traceCommitRecord(TraceWriter *writer) {
+    int active = writer->active;
+    writer->counts[active]++;
+    if (writer->counts[active] < TRACE_BUFFER_RECORDS) {
+        return;
+    }
+
+    // Hand the full buffer to the writer and wait only if it is still draining the other one
+    pthread_mutex_lock(&writer->lock);
+    writer->full[active] = 1;
+    pthread_cond_broadcast(&writer->changed);
+    while (writer->full[1 - active]) {
+        pthread_cond_wait(&writer->changed, &writer->lock);
+    }
+    writer->active = 1 - active;
+    pthread_mutex_unlock(&writer->lock);
+}
+
+int traceClose(TraceWriter *writer) {
+    pthread_mutex_lock(&writer->lock);
+    if (writer->counts[writer->active] > 0) {
+        writer->full[writer->active] = 1;
+    }
+    writer->closing = 1;
+    pthread_cond_broadcast(&writer->changed);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    if (writer->binary) {
+        TraceFooter footer;
+        footer.indexOffset = writer->offset;
+        footer.count = writer->indexCount;
+        memcpy(footer.magic, TRACE_INDEX_MAGIC, sizeof(footer.magic));
+        if (fwrite(writer->index, sizeof(uint64_t), writer->indexCount, writer->file) != writer->indexCount ||
+            fwrite(&footer, sizeof(TraceFooter), 1, writer->file) != 1) {
+            writer->error = 1;
+        }
+        if (fclose(writer->file) != 0) {
+            writer->error = 1;
+        }
+    } else if (fflush(writer->file) != 0) {
+        writer->error = 1;
+    }
+
+    int error = writer->error;
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->changed);
+    free(writer->buffers[0]);
+    free(writer->buffers[1]);
+    free(writer->index);
+    free(writer);
+
+    return error ? -1 : 0;
+}
@@ -0,0 +1,50 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Binary trace layout (native byte order):
+// 1. TraceHeader
+// 2. One fixed-size record per round: round, ball x, ball y, then rows * columns ints
+// 3. Index: one uint64_t file offset per record
+// 4. TraceFooter pointing at the index
+#define TRACE_MAGIC "FBTRACE"
+#define TRACE_INDEX_MAGIC "TIDX"
+#define TRACE_VERSION 1
+
+#define TRACE_TRAINING 1
+#define TRACE_MATCH 2
+
+#define TRACE_RECORD_HEADER_INTS 3
+#define TRACE_BUFFER_RECORDS 64
+
+typedef struct {
+    char magic[8];
+    int32_t version, kind, rows, columns;
+} TraceHeader;
+
+typedef struct {
+    uint64_t indexOffset;
+    uint32_t count;
+    char magic[4];
+} TraceFooter;
+
+typedef struct TraceWriter TraceWriter;
+
+// Opens a writer that drains round records on a background thread. With a NULL path the
+// records are formatted as text on stdout, otherwise they are written as a binary trace
+TraceWriter *traceOpen(const char *path, int kind, int rows, int columns);
+
+// Returns the slot for the next round record, to be filled in place and then committed
+int32_t *traceNextRecord(TraceWriter *writer);
+void traceCommitRecord(TraceWriter *writer);
+
+// Flushes all pending records, writes the index and returns 0 on success
+int traceClose(TraceWriter *writer);
+
+int traceRecordInts(TraceHeader *header);
+int traceReadHeader(FILE *file, TraceHeader *header);
+void traceFormatRecord(FILE *file, TraceHeader *header, const int32_t *record);
+
+#endif
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+// Converts a binary trace back into the text output of the simulation programs.
+// Usage: trace2text TRACE [FIRST_ROUND [LAST_ROUND]]
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "Usage: %s TRACE [FIRST_ROUND [LAST_ROUND]]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+    if (file == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    TraceHeader header;
+    if (traceReadHeader(file, &header) != 0) {
+        fprintf(stderr, "%s: not a trace file\n", argv[1]);
+        return 1;
+    }
+
+    // Locate the index through the footer at the end of the file
+    TraceFooter footer;
+    if (fseek(file, -(long) sizeof(TraceFooter), SEEK_END) != 0 ||
+        fread(&footer, sizeof(TraceFooter), 1, file) != 1 ||
+        memcmp(footer.magic, TRACE_INDEX_MAGIC, sizeof(footer.magic)) != 0) {
+        fprintf(stderr, "%s: missing trace index, the writer did not finish\n", argv[1]);
+        return 1;
+    }
+
+    uint64_t *index = malloc((footer.count + 1) * sizeof(uint64_t));
+    if (fseek(file, (long) footer.indexOffset, SEEK_SET) != 0 ||
+        fread(index, sizeof(uint64_t), footer.count, file) != footer.count) {
+        fprintf(stderr, "%s: truncated trace index\n", argv[1]);
+        return 1;
+    }
+
+    // Records are stored in consecutive round order, but a restarted run begins its trace at
+    // the restored round, so index entries count from the round of the first record
+    int recordInts = traceRecordInts(&header);
+    int32_t *record = malloc(recordInts * sizeof(int32_t));
+    long firstRound = 0;
+    if (footer.count > 0) {
+        if (fseek(file, (long) index[0], SEEK_SET) != 0 || fread(record, sizeof(int32_t), 1, file) != 1) {
+            fprintf(stderr, "%s: truncated record 0\n", argv[1]);
+            return 1;
+        }
+        firstRound = record[0];
+    }
+    long first = argc > 2 ? atol(argv[2]) - firstRound : 0;
+    long last = argc > 3 ? atol(argv[3]) - firstRound : (long) footer.count - 1;
+    if (first < 0) {
+        first = 0;
+    }
+    if (last >= (long) footer.count) {
+        last = (long) footer.count - 1;
+    }
+
+    long i;
+    for (i = first; i <= last; i++) {
+        if (fseek(file, (long) index[i], SEEK_SET) != 0 ||
+            fread(record, sizeof(int32_t), recordInts, file) != (size_t) recordInts) {
+            fprintf(stderr, "%s: truncated record %ld\n", argv[1], i);
+            return 1;
+        }
+        traceFormatRecord(stdout, &header, record);
+    }
+
+    free(record);
+    free(index);
+    fclose(file);
+
+    return 0;
+}
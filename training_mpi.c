@@ -1,9 +1,15 @@
+#include <inttypes.h>
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
-#define NUM_PROCS 12
+#include "profile.h"
+#include "rng.h"
+#include "trace.h"
+
+// Defaults of the runtime configuration
 #define NUM_ROUNDS 900
 #define NUM_PLAYERS 11
 
@@ -16,11 +22,24 @@
 #define PLAYER_WON_BALL 1
 #define PLAYER_LOST_BALL 0
 
+#define TRUE 1
+#define FALSE 0
+
 #define UP 1
 #define RIGHT 1
 #define DOWN -1
 #define LEFT -1
 
+// Profiled phases of a round
+#define PHASE_SEND_BALL 0
+#define PHASE_GET_BALL 1
+#define PHASE_MOVE 2
+#define PHASE_BARRIER 3
+#define PHASE_REPORTS 4
+#define PHASE_KICK 5
+#define PHASE_RECORD 6
+#define PHASES 7
+
 /* ==================== STRUCTS ====================*/
 typedef struct {
     int x, y;
@@ -37,36 +56,138 @@ typedef struct {
 
 typedef struct {
     Ball ball;
-    Player players[NUM_PLAYERS];
+    Player *players;
+
+    // Scratch space of the kick selection, indexed by player number from 1
+    int *kickSelection;
 } Field;
 
+typedef struct {
+    // Runtime shape of a training session, the macros above are its defaults. Every
+    // process apart from the field hosts a contiguous block of players
+    int fieldLength, fieldWidth, players, rounds;
+    int playerRanks;
+} Config;
+
+// A round is one message each way between the field and every player process, set up
+// once as persistent requests with fixed buffers, peers and tags:
+// 1. Field to player process: the ball position, which already includes the last kick
+// 2. Player process to field: the new positions and running stats of all its players
+// The field then selects the kicker and relocates the ball itself, the relocation is
+// drawn from the random stream keyed by the kicker so it is the same as the player's
+#define REPORT_INTS 5
+
+// With --compact a report is one 32-bit word per player with x, y and the reached bit.
+// The field keeps the running stats itself: clamping at the edges already takes the
+// overshoot off the distance, so a move adds exactly the squares between the previous
+// and the new position
+#define REPORT_COORD_BITS 12
+#define REPORT_COORD_LIMIT (1 << REPORT_COORD_BITS)
+
+typedef struct {
+    int compact;
+    int ballPosition[2];
+    int (*reports)[REPORT_INTS];
+    uint32_t *reportWords;
+    MPI_Request *ballRequests;
+    MPI_Request *reportRequests;
+} FieldChannels;
+
+typedef struct {
+    int compact;
+    int ballPosition[2];
+    int (*reports)[REPORT_INTS];
+    uint32_t *reportWords;
+    MPI_Request ballRequest;
+    MPI_Request reportRequest;
+} PlayerChannels;
+
+typedef struct {
+    int firstPlayer, count;
+    Player *players;
+} Hosted;
+
+typedef struct {
+    int dataflow, compact, timing, profile, hasSeed;
+    uint64_t seed;
+    char *tracePath;
+    Config config;
+} Options;
+
+// The field and the players run different halves of each exchange under the same phase
+const ProfilePhase phases[PHASES] = {
+    {"sendBallPositions", PROFILE_WAIT},
+    {"getBallPosition", PROFILE_WAIT},
+    {"moveTowardsBall", PROFILE_COMPUTE},
+    {"barrier", PROFILE_WAIT},
+    {"reports", PROFILE_WAIT},
+    {"kickBall", PROFILE_COMPUTE},
+    {"recordRound", PROFILE_COMPUTE},
+};
+
+Config config;
+
+/* ===================== UTILS =====================*/
+void *allocOrAbort(size_t size) {
+    void *memory = calloc(1, size);
+    if (memory == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    return memory;
+}
+
+// Player process rank hosts players getFirstPlayer(rank) up to getFirstPlayer(rank + 1)
+int getFirstPlayer(int rank) {
+    return (int) ((long) (rank - 1) * config.players / config.playerRanks);
+}
+
+int getHostedCount(int rank) {
+    return getFirstPlayer(rank + 1) - getFirstPlayer(rank);
+}
+
 /* ================= INIT FUNCTIONS =================*/
 void initField(Field *field) {
     // Initialize ball position to center of field
-    field->ball.x = FIELD_LENGTH / 2;
-    field->ball.y = FIELD_WIDTH / 2;
+    field->ball.x = config.fieldLength / 2;
+    field->ball.y = config.fieldWidth / 2;
 
-    // Initialize all player positions to 0
+    // Initialize all player positions to 0, the field keeps the kick count as it
+    // decides who kicks, and the other stats too when compact reports leave them out
     int p;
-    for (p = 0; p < NUM_PLAYERS; p++) {
+    field->players = allocOrAbort(config.players * sizeof(Player));
+    field->kickSelection = allocOrAbort((config.players + 1) * sizeof(int));
+    for (p = 0; p < config.players; p++) {
         field->players[p].x = 0;
         field->players[p].y = 0;
+        field->players[p].distance = field->players[p].reaches = field->players[p].kicks = 0;
     }
 }
 
-void initPlayer(Player *player) {
+void initPlayer(int index, Player *player, uint64_t seed) {
     // Initialize player position randomly
-    player->x = rand() % FIELD_LENGTH;
-    player->y = rand() % FIELD_WIDTH;
+    RngBlock draws = rngBlock(seed, RNG_NO_ROUND, index, RNG_INIT_PLAYER);
+    player->x = rngBelow(draws.v[0], config.fieldLength);
+    player->y = rngBelow(draws.v[1], config.fieldWidth);
     player->distance = player->reaches = player->kicks = 0;
     player->roundData.reached = player->roundData.kicked = PLAYER_LOST_BALL;
 }
 
+void initHosted(int rank, Hosted *hosted, uint64_t seed) {
+    int i;
+    hosted->firstPlayer = getFirstPlayer(rank);
+    hosted->count = getHostedCount(rank);
+    hosted->players = allocOrAbort(hosted->count * sizeof(Player));
+    for (i = 0; i < hosted->count; i++) {
+        initPlayer(hosted->firstPlayer + i, &hosted->players[i], seed);
+    }
+}
+
 void printField(Field *field) {
     printf("===================== FIELD INFO =====================\n");
     printf("Ball position: (%d, %d)\n", field->ball.x, field->ball.y);
     int p;
-    for (p = 1; p <= NUM_PLAYERS; p++) {
+    for (p = 1; p <= config.players; p++) {
         printf("Player %d position: (%d, %d)\n", p, field->players[p - 1].x, field->players[p - 1].y);
         printf("dist=%d, reaches=%d, kicks=%d, reached=%d, kicked=%d\n", 
             field->players[p - 1].distance, field->players[p - 1].reaches, field->players[p - 1].kicks, 
@@ -75,48 +196,134 @@ void printField(Field *field) {
     printf("======================================================\n");
 }
 
-/* ================ FIELD FUNCTIONS ================*/
-void fieldGetPositions(Field *field) {
-    int newPositions[NUM_PROCS][2];
-    MPI_Request reqs[NUM_PLAYERS];
-    MPI_Status stats[NUM_PLAYERS];
+/* ================ CHANNEL FUNCTIONS ================*/
+void freeRequests(MPI_Request *requests, int count) {
+    int i;
+    for (i = 0; i < count; i++) {
+        MPI_Request_free(&requests[i]);
+    }
+}
 
-    // Start non-blocking receives
-    int p;
-    for (p = 1; p <= NUM_PLAYERS; p++) {
-        MPI_Irecv(&newPositions[p], 2, MPI_INT, p, p, MPI_COMM_WORLD, &reqs[p - 1]);
+uint32_t packReport(Player *player) {
+    uint32_t mask = REPORT_COORD_LIMIT - 1;
+    return ((uint32_t) player->x & mask) | ((uint32_t) player->y & mask) << REPORT_COORD_BITS |
+        (uint32_t) (player->roundData.reached == PLAYER_REACHED_BALL) << (2 * REPORT_COORD_BITS);
+}
+
+void unpackReport(uint32_t word, int moved, Player *player) {
+    // The initial positions are not a move, they only place the player
+    uint32_t mask = REPORT_COORD_LIMIT - 1;
+    int x = (int) (word & mask);
+    int y = (int) (word >> REPORT_COORD_BITS & mask);
+    if (moved) {
+        player->distance += abs(x - player->x) + abs(y - player->y);
     }
-    MPI_Waitall(NUM_PLAYERS, reqs, stats);
+    player->x = x;
+    player->y = y;
+    player->roundData.reached = word >> (2 * REPORT_COORD_BITS) & 1 ? PLAYER_REACHED_BALL : PLAYER_LOST_BALL;
+    player->reaches += player->roundData.reached == PLAYER_REACHED_BALL;
+}
 
-    for (p = 1; p <= NUM_PLAYERS; p++) {
-        field->players[p - 1].x = newPositions[p][0];
-        field->players[p - 1].y = newPositions[p][1];
+void initFieldChannels(int compact, FieldChannels *channels) {
+    // Player process r talks to the field with tag r, its reports land in the rows of the
+    // players it hosts
+    int r;
+    channels->compact = compact;
+    channels->reports = NULL;
+    channels->reportWords = NULL;
+    if (compact) {
+        channels->reportWords = allocOrAbort(config.players * sizeof(uint32_t));
+    } else {
+        channels->reports = allocOrAbort(config.players * sizeof(int[REPORT_INTS]));
+    }
+    channels->ballRequests = allocOrAbort(config.playerRanks * sizeof(MPI_Request));
+    channels->reportRequests = allocOrAbort(config.playerRanks * sizeof(MPI_Request));
+    for (r = 1; r <= config.playerRanks; r++) {
+        MPI_Send_init(&channels->ballPosition, 2, MPI_INT, r, r, MPI_COMM_WORLD, &channels->ballRequests[r - 1]);
+        if (compact) {
+            MPI_Recv_init(&channels->reportWords[getFirstPlayer(r)], getHostedCount(r), MPI_UINT32_T, r, r,
+                MPI_COMM_WORLD, &channels->reportRequests[r - 1]);
+        } else {
+            MPI_Recv_init(&channels->reports[getFirstPlayer(r)], getHostedCount(r) * REPORT_INTS, MPI_INT, r, r,
+                MPI_COMM_WORLD, &channels->reportRequests[r - 1]);
+        }
     }
 }
 
-void fieldSendBallPositions(Field *field) {
-    int ballPosition[2];
-    ballPosition[0] = field->ball.x;
-    ballPosition[1] = field->ball.y;
-    MPI_Request reqs[NUM_PLAYERS];
-    MPI_Status stats[NUM_PLAYERS];
+void freeFieldChannels(FieldChannels *channels) {
+    freeRequests(channels->ballRequests, config.playerRanks);
+    freeRequests(channels->reportRequests, config.playerRanks);
+    free(channels->reports);
+    free(channels->reportWords);
+    free(channels->ballRequests);
+    free(channels->reportRequests);
+}
+
+void initPlayerChannels(int rank, int compact, Hosted *hosted, PlayerChannels *channels) {
+    channels->compact = compact;
+    channels->reports = NULL;
+    channels->reportWords = NULL;
+    MPI_Recv_init(&channels->ballPosition, 2, MPI_INT, FIELD_PROC, rank, MPI_COMM_WORLD, &channels->ballRequest);
+    if (compact) {
+        channels->reportWords = allocOrAbort(hosted->count * sizeof(uint32_t));
+        MPI_Send_init(channels->reportWords, hosted->count, MPI_UINT32_T, FIELD_PROC, rank, MPI_COMM_WORLD,
+            &channels->reportRequest);
+    } else {
+        channels->reports = allocOrAbort(hosted->count * sizeof(int[REPORT_INTS]));
+        MPI_Send_init(channels->reports, hosted->count * REPORT_INTS, MPI_INT, FIELD_PROC, rank, MPI_COMM_WORLD,
+            &channels->reportRequest);
+    }
+}
+
+void freePlayerChannels(PlayerChannels *channels) {
+    MPI_Request_free(&channels->ballRequest);
+    MPI_Request_free(&channels->reportRequest);
+    free(channels->reports);
+    free(channels->reportWords);
+}
+
+/* ================ FIELD FUNCTIONS ================*/
+void fieldStartReports(FieldChannels *channels) {
+    // Receives are posted before the players can answer so reports land straight in place
+    MPI_Startall(config.playerRanks, channels->reportRequests);
+}
+
+void fieldSendBallPositions(Field *field, FieldChannels *channels) {
+    channels->ballPosition[0] = field->ball.x;
+    channels->ballPosition[1] = field->ball.y;
+
+    fieldStartReports(channels);
+    MPI_Startall(config.playerRanks, channels->ballRequests);
+}
+
+void fieldGetReports(Field *field, FieldChannels *channels, int moved) {
+    // The ball sends were never started before the first round, waiting on them is a no-op
+    MPI_Waitall(config.playerRanks, channels->ballRequests, MPI_STATUSES_IGNORE);
+    MPI_Waitall(config.playerRanks, channels->reportRequests, MPI_STATUSES_IGNORE);
 
     int p;
-    for (p = 1; p <= NUM_PLAYERS; p++) {
-        MPI_Isend(&ballPosition, 2, MPI_INT, p, p, MPI_COMM_WORLD, &reqs[p - 1]);
+    for (p = 1; p <= config.players; p++) {
+        if (channels->compact) {
+            unpackReport(channels->reportWords[p - 1], moved, &field->players[p - 1]);
+        } else {
+            int *report = channels->reports[p - 1];
+            field->players[p - 1].x = report[0];
+            field->players[p - 1].y = report[1];
+            field->players[p - 1].distance = report[2];
+            field->players[p - 1].reaches = report[3];
+            field->players[p - 1].roundData.reached = report[4];
+        }
+        field->players[p - 1].roundData.kicked = PLAYER_LOST_BALL;
     }
-    MPI_Waitall(NUM_PLAYERS, reqs, stats);
 }
 
-void fieldSendKickSelection(Field *field) {
-    int kickSelection[NUM_PROCS];
-    MPI_Request reqs[NUM_PLAYERS];
-    MPI_Status stats[NUM_PLAYERS];
-    
+void fieldKickBall(Field *field, int round, uint64_t seed) {
+    int *kickSelection = field->kickSelection;
+
     // Mark players who have reached the same square as the ball
     int p;
     int playersAtBallPosition = 0;
-    for (p = 1; p <= NUM_PLAYERS; p++) {
+    for (p = 1; p <= config.players; p++) {
         if (field->players[p - 1].x == field->ball.x && 
             field->players[p - 1].y == field->ball.y) {
             kickSelection[p] = PLAYER_WON_BALL;
@@ -128,9 +335,10 @@ void fieldSendKickSelection(Field *field) {
 
     // Handle random selection for ball winning
     if (playersAtBallPosition > 1) {
-        int selectedPlayer = rand() % playersAtBallPosition;
+        RngBlock draws = rngBlock(seed, round, RNG_NO_PLAYER, RNG_KICK_SELECTION);
+        int selectedPlayer = rngBelow(draws.v[0], playersAtBallPosition);
         int playerIndex = 0;
-        for (p = 1; p <= NUM_PLAYERS; p++) {
+        for (p = 1; p <= config.players; p++) {
             if (kickSelection[p] == PLAYER_WON_BALL) {
                 if (playerIndex != selectedPlayer) {
                     kickSelection[p] = PLAYER_LOST_BALL;
@@ -140,85 +348,54 @@ void fieldSendKickSelection(Field *field) {
         }
     }
 
-    // Send kick selections
-    for (p = 1; p <= NUM_PLAYERS; p++) {
-        MPI_Isend(&kickSelection[p], 1, MPI_INT, p, p, MPI_COMM_WORLD, &reqs[p - 1]);
-    }
-    MPI_Waitall(NUM_PLAYERS, reqs, stats);
-}
-
-void fieldGetKickResult(Field *field) {
-    int newBallPositions[NUM_PROCS][3];
-    MPI_Request reqs[NUM_PLAYERS];
-    MPI_Status stats[NUM_PLAYERS];
-
-    int p;
-    for (p = 1; p <= NUM_PLAYERS; p++) {
-        MPI_Irecv(&newBallPositions[p], 3, MPI_INT, p, p, MPI_COMM_WORLD, &reqs[p - 1]);
-    }
-    MPI_Waitall(NUM_PLAYERS, reqs, stats);
-
-    // Only update the ball location if it has been kicked
-    for (p = 1; p <= NUM_PLAYERS; p++) {
-        if (newBallPositions[p][2] == PLAYER_WON_BALL) {
-            field->ball.x = newBallPositions[p][0];
-            field->ball.y = newBallPositions[p][1];
+    // The selected player randomly relocates the ball on the field
+    for (p = 1; p <= config.players; p++) {
+        if (kickSelection[p] == PLAYER_WON_BALL) {
+            RngBlock draws = rngBlock(seed, round, p - 1, RNG_KICK);
+            field->ball.x = rngBelow(draws.v[0], config.fieldLength);
+            field->ball.y = rngBelow(draws.v[1], config.fieldWidth);
+            field->players[p - 1].kicks++;
+            field->players[p - 1].roundData.kicked = PLAYER_WON_BALL;
             // printf("Ball is now at (%d, %d)\n", field->ball.x, field->ball.y);
             break;
         }
     }
 }
 
-void fieldGetRoundData(Field *field) {
-    int roundData[NUM_PROCS][5];
-    MPI_Request reqs[NUM_PLAYERS];
-    MPI_Status stats[NUM_PLAYERS];
-
-    int p;
-    for (p = 1; p <= NUM_PLAYERS; p++) {
-        MPI_Irecv(&roundData[p], 5, MPI_INT, p, p, MPI_COMM_WORLD, &reqs[p - 1]);
-    }
-    MPI_Waitall(NUM_PLAYERS, reqs, stats);
-
-    // Update all the round data for all players
-    for (p = 1; p <= NUM_PLAYERS; p++) {
-        field->players[p - 1].distance = roundData[p][0];
-        field->players[p - 1].reaches = roundData[p][1];
-        field->players[p - 1].kicks = roundData[p][2];
-        field->players[p - 1].roundData.reached = roundData[p][3];
-        field->players[p - 1].roundData.kicked = roundData[p][4];
-    }
-}
-
 /* =============== PLAYER FUNCTIONS ================*/
-void playerSendPosition(int rank, int x, int y) {
-    int newPosition[2];
-    newPosition[0] = x;
-    newPosition[1] = y;
+void playerGetBallPosition(PlayerChannels *channels, Ball *ball) {
+    MPI_Start(&channels->ballRequest);
+    MPI_Wait(&channels->ballRequest, MPI_STATUS_IGNORE);
 
-    MPI_Request req;
-    MPI_Status stats;
+    // Update player's internal ball position
+    ball->x = channels->ballPosition[0];
+    ball->y = channels->ballPosition[1];
 
-    MPI_Isend(&newPosition, 2, MPI_INT, FIELD_PROC, rank, MPI_COMM_WORLD, &req);
-    MPI_Wait(&req, &stats);
+    // printf("player knows ball is at (%d, %d)\n", ball->x, ball->y);
 }
 
-void playerGetBallPosition(int rank, Ball *ball) {
-    int ballPosition[2];
-    MPI_Request req;
-    MPI_Status stats;
-
-    MPI_Irecv(&ballPosition, 2, MPI_INT, FIELD_PROC, rank, MPI_COMM_WORLD, &req);
-    MPI_Wait(&req, &stats);
-
-    // Update player's internal ball position
-    ball->x = ballPosition[0];
-    ball->y = ballPosition[1];
+void playerSendReport(PlayerChannels *channels, Hosted *hosted) {
+    // The reports of all hosted players travel in one message
+    int i;
+    for (i = 0; i < hosted->count; i++) {
+        Player *player = &hosted->players[i];
+        if (channels->compact) {
+            channels->reportWords[i] = packReport(player);
+        } else {
+            int *report = channels->reports[i];
+            report[0] = player->x;
+            report[1] = player->y;
+            report[2] = player->distance;
+            report[3] = player->reaches;
+            report[4] = player->roundData.reached;
+        }
+    }
 
-    // printf("player %d knows ball is at (%d, %d)\n", rank, ball->x, ball->y);
+    MPI_Start(&channels->reportRequest);
+    MPI_Wait(&channels->reportRequest, MPI_STATUS_IGNORE);
 }
 
-void playerMoveTowardsBall(int rank, Ball *ball, Player *player) {
+void playerMoveTowardsBall(int index, Ball *ball, Player *player, int round, uint64_t seed) {
     // Movement rules:
     // 1. Stop when ball is reached, or
     // 2. Moved 10m (assume no diagonal movement)
@@ -231,7 +408,7 @@ void playerMoveTowardsBall(int rank, Ball *ball, Player *player) {
     int horizontalDistanceToBall = abs(ball->x - player->x);
     int verticalDistanceToBall = abs(ball->y - player->y);
     if (verticalDistanceToBall + horizontalDistanceToBall <= PLAYER_DIST) {
-        // printf("player %d (%d, %d) moving to ball(%d, %d)\n", rank, player->x, player->y, ball->x, ball->y);
+        // printf("player %d (%d, %d) moving to ball(%d, %d)\n", index, player->x, player->y, ball->x, ball->y);
         player->x = ball->x;
         player->y = ball->y;
         player->distance += (verticalDistanceToBall + horizontalDistanceToBall);
@@ -242,10 +419,11 @@ void playerMoveTowardsBall(int rank, Ball *ball, Player *player) {
 
     // Determine direction to travel towards ball, and move a random combined distance of 
     // PLAYER_DIST squares in both directions
-    // printf("player %d (%d, %d) moving to square", rank, player->x, player->y);
+    // printf("player %d (%d, %d) moving to square", index, player->x, player->y);
     int horizontalDirection = (ball->x - player->x) > 0 ? RIGHT : LEFT;
     int verticalDirection = (ball->y - player->y) > 0 ? UP : DOWN;
-    int horizontalDistance = rand() % (PLAYER_DIST + 1);
+    RngBlock draws = rngBlock(seed, round, index, RNG_MOVE);
+    int horizontalDistance = rngBelow(draws.v[0], PLAYER_DIST + 1);
     int verticalDistance = PLAYER_DIST - horizontalDistance;
     player->x += horizontalDistance * horizontalDirection;
     player->y += verticalDistance * verticalDirection;
@@ -261,63 +439,117 @@ void playerMoveTowardsBall(int rank, Ball *ball, Player *player) {
         player->distance -= (0 - player->y);
         player->y = 0;
     }
-    if (player->x >= FIELD_LENGTH) {
-        player->distance -= (player->x - (FIELD_LENGTH - 1));
-        player->x = FIELD_LENGTH - 1;
+    if (player->x >= config.fieldLength) {
+        player->distance -= (player->x - (config.fieldLength - 1));
+        player->x = config.fieldLength - 1;
     }
-    if (player->y >= FIELD_WIDTH) {
-        player->distance -= (player->y - (FIELD_WIDTH - 1));
-        player->y = FIELD_WIDTH - 1;
+    if (player->y >= config.fieldWidth) {
+        player->distance -= (player->y - (config.fieldWidth - 1));
+        player->y = config.fieldWidth - 1;
     }
     
     // printf("(%d, %d)\n", player->x, player->y);
 }
 
-void playerGetKickSelection(int rank, Ball *ball, Player *player) {
-    int kickSelection;
-    MPI_Request req;
-    MPI_Status stats;
-
-    MPI_Irecv(&kickSelection, 1, MPI_INT, FIELD_PROC, rank, MPI_COMM_WORLD, &req);
-    MPI_Wait(&req, &stats);
-
-    // printf("player %d's kick selection: %d\n", rank, kickSelection);
-
-    // If player gets selected to kick, randomly relocate the ball on the field
-    if (kickSelection == PLAYER_WON_BALL) {
-        ball->x = rand() % FIELD_LENGTH;
-        ball->y = rand() % FIELD_WIDTH;
-        player->kicks++;
-        player->roundData.kicked = PLAYER_WON_BALL;
+void playersMoveTowardsBall(Hosted *hosted, Ball *ball, int round, uint64_t seed) {
+    int i;
+    for (i = 0; i < hosted->count; i++) {
+        // Reset the roundData for every new round
+        hosted->players[i].roundData.reached = PLAYER_LOST_BALL;
+        playerMoveTowardsBall(hosted->firstPlayer + i, ball, &hosted->players[i], round, seed);
     }
 }
 
-void playerSendKickResult(int rank, Ball *ball, Player *player) {
-    int newBallPosition[3];
-    newBallPosition[0] = ball->x;
-    newBallPosition[1] = ball->y;
-    newBallPosition[2] = player->roundData.kicked;
-
-    MPI_Request req;
-    MPI_Status stats;
+/* =============== OPTIONS AND TIMING ==============*/
+void parseOptions(int rank, int argc, char *argv[], Options *options) {
+    options->dataflow = FALSE;
+    options->compact = FALSE;
+    options->timing = FALSE;
+    options->profile = FALSE;
+    options->hasSeed = FALSE;
+    options->tracePath = NULL;
+    options->config.fieldLength = FIELD_LENGTH;
+    options->config.fieldWidth = FIELD_WIDTH;
+    options->config.players = NUM_PLAYERS;
+    options->config.rounds = NUM_ROUNDS;
+
+    Config *config = &options->config;
+    int i;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dataflow") == 0) {
+            options->dataflow = TRUE;
+        } else if (strcmp(argv[i], "--compact") == 0) {
+            options->compact = TRUE;
+        } else if (strcmp(argv[i], "--timing") == 0) {
+            options->timing = TRUE;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            options->profile = TRUE;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options->hasSeed = TRUE;
+            options->seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options->tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--field") == 0 && i + 1 < argc &&
+            sscanf(argv[i + 1], "%dx%d", &config->fieldLength, &config->fieldWidth) == 2) {
+            i++;
+        } else if (strcmp(argv[i], "--players") == 0 && i + 1 < argc) {
+            config->players = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            config->rounds = atoi(argv[++i]);
+        } else {
+            if (rank == FIELD_PROC) {
+                fprintf(stderr, "Unknown option %s\nUsage: %s [--dataflow] [--compact] [--timing] [--profile] [--seed N] [--trace FILE]\n"
+                    "    [--field LxW] [--players N] [--rounds N]\n", argv[i], argv[0]);
+            }
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+}
 
-    MPI_Isend(&newBallPosition, 3, MPI_INT, FIELD_PROC, rank, MPI_COMM_WORLD, &req);
-    MPI_Wait(&req, &stats);
+void setupConfig(int rank, int numprocs, Options *options) {
+    // Every process parses the same arguments, so they all agree on the configuration
+    const char *error = NULL;
+    config = options->config;
+    config.playerRanks = numprocs - 1;
+    if (config.fieldLength < 1 || config.fieldWidth < 1) {
+        error = "the field needs at least one square";
+    } else if (config.rounds < 1) {
+        error = "a session needs at least one round";
+    } else if (config.playerRanks < 1 || config.playerRanks > config.players) {
+        error = "every process apart from the field needs at least one player";
+    } else if (options->compact && (config.fieldLength >= REPORT_COORD_LIMIT || config.fieldWidth >= REPORT_COORD_LIMIT)) {
+        error = "--compact packs coordinates into 12 bits, the field is too large for it";
+    }
+    if (error != NULL) {
+        if (rank == FIELD_PROC) {
+            fprintf(stderr, "Cannot run this session: %s\n", error);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 }
 
-void playerSendRoundData(int rank, Ball *ball, Player *player) {
-    int roundData[5];
-    MPI_Request req;
-    MPI_Status stats;
+uint64_t shareSeed(int rank, Options *options) {
+    // Without --seed, one process picks a seed from the clock and reports it so the run
+    // can be reproduced, every process then draws from the same seed
+    uint64_t seed = options->hasSeed ? options->seed : (uint64_t) time(0);
+    MPI_Bcast(&seed, 1, MPI_UINT64_T, FIELD_PROC, MPI_COMM_WORLD);
+    if (rank == FIELD_PROC && !options->hasSeed) {
+        fprintf(stderr, "seed=%" PRIu64 "\n", seed);
+    }
+    return seed;
+}
 
-    roundData[0] = player->distance; 
-    roundData[1] = player->reaches;
-    roundData[2] = player->kicks;
-    roundData[3] = player->roundData.reached;
-    roundData[4] = player->roundData.kicked;
+void printRoundTiming(int rank, Options *options, int rounds, double elapsed, double slowestRound) {
+    // A round is only as fast as the slowest process, so report the maximum over all ranks
+    double maxElapsed, maxSlowestRound;
+    MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, FIELD_PROC, MPI_COMM_WORLD);
+    MPI_Reduce(&slowestRound, &maxSlowestRound, 1, MPI_DOUBLE, MPI_MAX, FIELD_PROC, MPI_COMM_WORLD);
 
-    MPI_Isend(&roundData, 5, MPI_INT, FIELD_PROC, rank, MPI_COMM_WORLD, &req);
-    MPI_Wait(&req, &stats);
+    if (rank == FIELD_PROC) {
+        fprintf(stderr, "schedule=%s%s players=%d/%d rounds=%d total=%.3fs round mean=%.1fus max=%.1fus\n",
+            options->dataflow ? "dataflow" : "barrier", options->compact ? "/compact" : "", config.players, config.playerRanks, rounds, maxElapsed,
+            maxElapsed / rounds * 1e6, maxSlowestRound * 1e6);
+    }
 }
 
 /* ======================= MAIN ========================*/
@@ -328,39 +560,74 @@ int main(int argc, char *argv[]) {
     // MPI_Request sendReqs[NUM_PLAYERS], recvReqs[NUM_PLAYERS];
     // MPI_Status sendStats[NUM_PLAYERS], recvStats[NUM_PLAYERS];
 
-    MPI_Init(&argc, &argv);
+    // Only the main thread makes MPI calls, the trace writer thread never does
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     MPI_Comm_size(MPI_COMM_WORLD, &numprocs);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    srand(time(0) + rank);
+
+    // In dataflow mode processes only synchronize through the messages they exchange
+    Options options;
+    parseOptions(rank, argc, argv, &options);
+    setupConfig(rank, numprocs, &options);
+    uint64_t seed = shareSeed(rank, &options);
+
+    // The field process hands every round to a writer thread instead of printing it
+    TraceWriter *trace = NULL;
+    if (rank == FIELD_PROC) {
+        trace = traceOpen(options.tracePath, TRACE_TRAINING, config.players, 10);
+        if (trace == NULL) {
+            fprintf(stderr, "Cannot open trace file %s\n", options.tracePath);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
 
     // Initialize private data per process
     Field field, previousField;
-    Player player;
+    Hosted hosted;
     Ball ball;
+    previousField.players = NULL;
     if (rank == FIELD_PROC) {
         initField(&field);
+        previousField.players = allocOrAbort(config.players * sizeof(Player));
     } else {
-        initPlayer(&player);
+        initHosted(rank, &hosted, seed);
     }
 
     // Wait for all initialization to finish
-    MPI_Barrier(MPI_COMM_WORLD);
+    if (!options.dataflow) {
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
 
-    // Send/receive initial position data to/from player processes
+    // Set up every message of a round once, then send/receive initial position data
+    // to/from player processes
+    FieldChannels fieldChannels;
+    PlayerChannels playerChannels;
     if (rank == FIELD_PROC) {
-        fieldGetPositions(&field);
+        initFieldChannels(options.compact, &fieldChannels);
+        fieldStartReports(&fieldChannels);
+        fieldGetReports(&field, &fieldChannels, FALSE);
     } else {
-        playerSendPosition(rank, player.x, player.y);
+        initPlayerChannels(rank, options.compact, &hosted, &playerChannels);
+        playerSendReport(&playerChannels, &hosted);
     }
 
+    Profile profile;
+    profileInit(&profile, options.profile, phases, PHASES, MPI_COMM_WORLD);
+
     // Run for n rounds
     int r;
-    for (r = 0; r < NUM_ROUNDS; r++) {
+    double loopStart = MPI_Wtime();
+    double slowestRound = 0;
+    for (r = 0; r < config.rounds; r++) {
+        double roundStart = MPI_Wtime();
+        profileMark(&profile, PROFILE_NO_PHASE);
+
         // Update the previous field state
         if (rank == FIELD_PROC) {
             previousField.ball.x = field.ball.x;
             previousField.ball.y = field.ball.y;
-            for (p = 0; p < NUM_PLAYERS; p++) {
+            for (p = 0; p < config.players; p++) {
                 previousField.players[p].x = field.players[p].x;
                 previousField.players[p].y = field.players[p].y;
                 // previousField.players[p].distance = field.players[p].distance;
@@ -372,46 +639,87 @@ int main(int argc, char *argv[]) {
         }
 
         if (rank == FIELD_PROC) {
-            fieldSendBallPositions(&field);
+            fieldSendBallPositions(&field, &fieldChannels);
+            profileMark(&profile, PHASE_SEND_BALL);
         } else {
-            // Reset the roundData for every new round
-            player.roundData.reached = PLAYER_LOST_BALL;
-            player.roundData.kicked = PLAYER_LOST_BALL;
-
-            playerGetBallPosition(rank, &ball);
-            playerMoveTowardsBall(rank, &ball, &player);
+            playerGetBallPosition(&playerChannels, &ball);
+            profileMark(&profile, PHASE_GET_BALL);
+            playersMoveTowardsBall(&hosted, &ball, r, seed);
+            profileMark(&profile, PHASE_MOVE);
         }
 
-        // Wait for all player movement to finish
-        MPI_Barrier(MPI_COMM_WORLD);
+        // Wait for all player movement to finish, the report receives below already
+        // wait for every player in dataflow mode
+        if (!options.dataflow) {
+            MPI_Barrier(MPI_COMM_WORLD);
+            profileMark(&profile, PHASE_BARRIER);
+        }
 
         if (rank == FIELD_PROC) {
-            fieldGetPositions(&field);
-            fieldSendKickSelection(&field);
-            fieldGetKickResult(&field);
-            fieldGetRoundData(&field);
+            fieldGetReports(&field, &fieldChannels, TRUE);
+            profileMark(&profile, PHASE_REPORTS);
+            fieldKickBall(&field, r, seed);
+            profileMark(&profile, PHASE_KICK);
         } else {
-            playerSendPosition(rank, player.x, player.y);
-            playerGetKickSelection(rank, &ball, &player);
-            playerSendKickResult(rank, &ball, &player);
-            playerSendRoundData(rank, &ball, &player);
+            playerSendReport(&playerChannels, &hosted);
+            profileMark(&profile, PHASE_REPORTS);
         }
 
-        // Ensure field is updated before proceeding to next round
-        MPI_Barrier(MPI_COMM_WORLD);
+        // Ensure field is updated before proceeding to next round, messages between a pair
+        // of processes are non-overtaking so the next round cannot mix with this one
+        if (!options.dataflow) {
+            MPI_Barrier(MPI_COMM_WORLD);
+            profileMark(&profile, PHASE_BARRIER);
+        }
 
         if (rank == FIELD_PROC) {
             // printField(&field);
-            printf("%d\n", r);
-            printf("%d %d\n", field.ball.x, field.ball.y);
-            for (p = 0; p < NUM_PLAYERS; p++) {
-                printf("%d %d %d %d %d %d %d %d %d %d\n", p, previousField.players[p].x, previousField.players[p].y, 
-                    field.players[p].x, field.players[p].y, 
-                    field.players[p].roundData.reached, field.players[p].roundData.kicked, 
-                    field.players[p].distance, field.players[p].reaches, field.players[p].kicks);
+            int32_t *record = traceNextRecord(trace);
+            record[0] = r;
+            record[1] = field.ball.x;
+            record[2] = field.ball.y;
+            int32_t *row = &record[TRACE_RECORD_HEADER_INTS];
+            for (p = 0; p < config.players; p++) {
+                row[0] = p;
+                row[1] = previousField.players[p].x;
+                row[2] = previousField.players[p].y;
+                row[3] = field.players[p].x;
+                row[4] = field.players[p].y;
+                row[5] = field.players[p].roundData.reached;
+                row[6] = field.players[p].roundData.kicked;
+                row[7] = field.players[p].distance;
+                row[8] = field.players[p].reaches;
+                row[9] = field.players[p].kicks;
+                row += 10;
             }
-            printf("\n");
+            traceCommitRecord(trace);
+            profileMark(&profile, PHASE_RECORD);
         }
+        profileEndRound(&profile);
+
+        double roundTime = MPI_Wtime() - roundStart;
+        if (roundTime > slowestRound) {
+            slowestRound = roundTime;
+        }
+    }
+
+    if (options.timing) {
+        printRoundTiming(rank, &options, config.rounds, MPI_Wtime() - loopStart, slowestRound);
+    }
+    profileReport(&profile, rank, FIELD_PROC, MPI_COMM_WORLD);
+
+    if (rank == FIELD_PROC && traceClose(trace) != 0) {
+        fprintf(stderr, "Failed to write round output\n");
+    }
+
+    if (rank == FIELD_PROC) {
+        freeFieldChannels(&fieldChannels);
+        free(field.players);
+        free(field.kickSelection);
+        free(previousField.players);
+    } else {
+        freePlayerChannels(&playerChannels);
+        free(hosted.players);
     }
 
     MPI_Finalize();